@@ -0,0 +1,138 @@
+import scala.scalanative.native._
+import scala.scalanative.runtime._
+
+/** Small workloads of the garbage collector, run one at a time with
+ *  `benchmarks/run <name>`. Each prints its timings and the counters of the
+ *  gc, so that the same workload can be compared across gc settings.
+ */
+object GCBenchmarks {
+  final class Node(val left: Node, val right: Node)
+
+  def tree(depth: Int): Node =
+    if (depth == 0) null else new Node(tree(depth - 1), tree(depth - 1))
+
+  def count(node: Node): Int =
+    if (node == null) 0 else 1 + count(node.left) + count(node.right)
+
+  def millis(nanos: Long): String = s"${nanos / 1000000} ms"
+
+  /** Pause of a full collection with a live tree of 2M objects. */
+  def mark(): Unit = {
+    val live = tree(21)
+    GC.collect()
+    val start = System.nanoTime()
+    var i     = 0
+    while (i < 10) {
+      GC.collect()
+      i += 1
+    }
+    val pause = (System.nanoTime() - start) / 10
+    assert(count(live) == (1 << 21) - 1)
+    println(s"mark: ${millis(pause)} per collection")
+  }
+
+  /** Arrays of 64 KB to 9 MB, eight of them live at a time. */
+  def large(): Unit = {
+    val random = new java.util.Random(7)
+    val live   = new Array[Array[Long]](8)
+    val start  = System.nanoTime()
+    var i      = 0
+    while (i < 4000) {
+      live(i % 8) = new Array[Long](8192 + random.nextInt(9 * 131072 - 8192))
+      i += 1
+    }
+    println(s"large: ${millis(System.nanoTime() - start)}")
+  }
+
+  /** Arrays of 64 KB to 1.1 MB, 64 of them live at a time and replaced at
+   *  random, so that the free chunks of the large heap come in every size.
+   */
+  def largeFragmented(): Unit = {
+    val random = new java.util.Random(17)
+    val live   = new Array[Array[Long]](64)
+    val start  = System.nanoTime()
+    var i      = 0
+    while (i < 20000) {
+      live(random.nextInt(64)) =
+        new Array[Long](8192 + random.nextInt(144 * 1024 - 8192))
+      i += 1
+    }
+    println(s"largeFragmented: ${millis(System.nanoTime() - start)}")
+  }
+
+  /** 50M short lived small objects next to a live tree of 65k objects. */
+  def small(): Unit = {
+    val live  = tree(16)
+    val start = System.nanoTime()
+    var last  = live
+    var i     = 0
+    while (i < 50000000) {
+      last = new Node(null, null)
+      i += 1
+    }
+    println(s"small: ${millis(System.nanoTime() - start)}")
+    assert(last != null && count(live) == (1 << 16) - 1)
+  }
+
+  /** Arrays of 256 B to 8 KB next to a changing set of small objects. */
+  def medium(): Unit = {
+    val random = new java.util.Random(11)
+    val small  = new Array[Node](8192)
+    val live   = new Array[Array[Node]](128)
+    val start  = System.nanoTime()
+    var round  = 0
+    while (round < 150000) {
+      var k = 0
+      while (k < 4) {
+        small(random.nextInt(8192)) = new Node(null, null)
+        k += 1
+      }
+      live(round % 128) = new Array[Node](30 + random.nextInt(994))
+      round += 1
+    }
+    println(s"medium: ${millis(System.nanoTime() - start)}")
+  }
+
+  /** Arrays of 256 B to 8 KB next to 256k small objects, replaced at random
+   *  so that their blocks are full of holes of every size.
+   */
+  def fragmented(): Unit = {
+    val random = new java.util.Random(13)
+    val small  = Array.fill[Node](262144)(new Node(null, null))
+    val live   = new Array[Array[Node]](256)
+    val start  = System.nanoTime()
+    var round  = 0
+    while (round < 300000) {
+      var k = 0
+      while (k < 8) {
+        small(random.nextInt(262144)) = new Node(null, null)
+        k += 1
+      }
+      live(round % 256) = new Array[Node](30 + random.nextInt(994))
+      round += 1
+    }
+    println(s"fragmented: ${millis(System.nanoTime() - start)}")
+  }
+
+  def main(args: Array[String]): Unit = {
+    args.headOption match {
+      case Some("mark")            => mark()
+      case Some("large")           => large()
+      case Some("largeFragmented") => largeFragmented()
+      case Some("small")           => small()
+      case Some("medium")          => medium()
+      case Some("fragmented")      => fragmented()
+      case _ =>
+        println(
+          "usage: benchmarks/run " +
+            "mark|large|largeFragmented|small|medium|fragmented")
+    }
+    val stats = stackalloc[GC.GCStats]
+    GC.stats(stats)
+    println(
+      s"collections ${stats.collections}, " +
+        s"mark ${millis(stats.markNanos.toLong)}, " +
+        s"sweep ${millis(stats.sweepNanos.toLong)}, " +
+        s"heap ${stats.heapBytes.toLong / (1024 * 1024)} MB")
+  }
+}
@@ -25,8 +25,10 @@ object System {
     Runtime.getRuntime().exit(status)
   }
 
-  def identityHashCode(x: Object): scala.Int =
+  def identityHashCode(x: Object): scala.Int = {
+    if (scalanative.runtime.gcMovesObjects) GC.pin(x.cast[Ptr[scala.Byte]])
     x.cast[Word].hashCode
+  }
 
   private def loadProperties() = {
     val sysProps = new Properties()
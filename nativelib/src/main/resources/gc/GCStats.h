@@ -0,0 +1,26 @@
+#ifndef GC_STATS_H
+#define GC_STATS_H
+
+#include <stdint.h>
+
+/**
+ * Counters of the collector since the program started, copied out by
+ * `scalanative_gc_stats`. Every collector fills this layout, counters it does
+ * not keep stay 0. It is mirrored by `GC.GCStats` on the Scala side.
+ */
+typedef struct {
+    uint64_t collections;
+    uint64_t pauseNanos;
+    uint64_t maxPauseNanos;
+    uint64_t markNanos;
+    uint64_t sweepNanos;
+    uint64_t largeSweepNanos;
+    uint64_t allocatedBytes;
+    uint64_t freedBytes;
+    uint64_t heapBytes;
+    uint64_t freeBlocks;
+    uint64_t recycledBlocks;
+    uint64_t unavailableBlocks;
+} GCStats;
+
+#endif // GC_STATS_H
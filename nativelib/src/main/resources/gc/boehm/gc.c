@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../GCStats.h"
 
 // At the moment we rely on the conservative
 // mode of Boehm GC as our garbage collector.
@@ -34,3 +37,58 @@ void *scalanative_alloc_atomic(void *info, size_t size) {
 }
 
 void scalanative_collect() { GC_gcollect(); }
+
+// Boehm GC does not mark concurrently, there is nothing to log
+void scalanative_copy_references(void *to, void *from, size_t size) {
+    memmove(to, from, size);
+}
+
+// Boehm GC does not move objects
+bool scalanative_gc_moves_objects() { return false; }
+
+void scalanative_pin(void *address) {
+    (void)address;
+}
+
+// Threads are not registered with Boehm GC
+void scalanative_register_thread(void *stackBottom) {
+    (void)stackBottom;
+}
+void scalanative_unregister_thread() {}
+
+// Boehm GC only reports its heap usage, the timings and block counts stay 0
+void scalanative_gc_stats(GCStats *stats) {
+    GC_word heapSize, freeBytes, unmappedBytes, bytesSinceGC, totalBytes;
+    GC_get_heap_usage_safe(&heapSize, &freeBytes, &unmappedBytes,
+                           &bytesSinceGC, &totalBytes);
+    memset(stats, 0, sizeof(GCStats));
+    stats->collections = GC_get_gc_no();
+    stats->allocatedBytes = totalBytes;
+    stats->heapBytes = heapSize;
+    GC_word usedBytes = heapSize - freeBytes;
+    if (totalBytes > usedBytes) {
+        stats->freedBytes = totalBytes - usedBytes;
+    }
+}
+
+// There is no trace, allocation profile nor heap dump to write
+int scalanative_gc_trace_dump(const char *path) {
+    (void)path;
+    return -1;
+}
+
+int scalanative_gc_profile_dump(const char *path, int format) {
+    (void)path;
+    (void)format;
+    return -1;
+}
+
+int scalanative_gc_heap_histogram(const char *path) {
+    (void)path;
+    return -1;
+}
+
+int scalanative_gc_heap_dump(const char *path) {
+    (void)path;
+    return -1;
+}
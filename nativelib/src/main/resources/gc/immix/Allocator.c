@@ -2,11 +2,13 @@
 #include "Allocator.h"
 #include "Line.h"
 #include "Block.h"
+#include "State.h"
 #include <stdio.h>
 #include <memory.h>
 
-BlockHeader *Allocator_getNextBlock(Allocator *allocator);
-bool Allocator_getNextLine(Allocator *allocator);
+BlockHeader *Allocator_getNextBlock(Allocator *allocator, Tlab *tlab);
+bool Allocator_getNextLine(Allocator *allocator, Tlab *tlab);
+BlockHeader *Allocator_sweepNextBlock(Allocator *allocator);
 
 /**
  *
@@ -19,8 +21,12 @@ bool Allocator_getNextLine(Allocator *allocator);
 void Allocator_Init(Allocator *allocator, word_t *heapStart, int blockCount) {
     allocator->heapStart = heapStart;
 
-    BlockList_Init(&allocator->recycledBlocks, heapStart);
+    for (int i = 0; i < RECYCLED_BLOCK_CLASSES; i++) {
+        BlockList_Init(&allocator->recycledBlocks[i], heapStart);
+    }
     BlockList_Init(&allocator->freeBlocks, heapStart);
+    BlockList_Init(&allocator->decommittedBlocks, heapStart);
+    allocator->decommittedBlockCount = 0;
 
     // Init the free block list
     allocator->freeBlocks.first = (BlockHeader *)heapStart;
@@ -34,11 +40,15 @@ void Allocator_Init(Allocator *allocator, word_t *heapStart, int blockCount) {
     allocator->freeBlockCount = (uint64_t)blockCount;
     allocator->recycledBlockCount = 0;
 
-    Allocator_InitCursors(allocator);
+    allocator->lazySweep = false;
+    allocator->sweepCursor = NULL;
+    allocator->sweepLimit = NULL;
+    allocator->markedBlockCount = 0;
+    allocator->markedLineCount = 0;
 }
 
 /**
- * The Allocator needs one free block for overflow allocation and a free or
+ * A thread needs one free block for overflow allocation and a free or
  * recyclable block for normal allocation.
  *
  * @param allocator
@@ -46,209 +56,468 @@ void Allocator_Init(Allocator *allocator, word_t *heapStart, int blockCount) {
  * otherwise.
  */
 bool Allocator_CanInitCursors(Allocator *allocator) {
+    // Unswept blocks might still hold free lines
+    if (Allocator_HasUnsweptBlocks(allocator)) {
+        return true;
+    }
     return allocator->freeBlockCount >= 2 ||
            (allocator->freeBlockCount == 1 &&
             allocator->recycledBlockCount > 0);
 }
 
 /**
- *
- * Used to initialise the cursors of the Allocator after collection
- *
- * @param allocator
+ * Empties the allocation buffer of a thread, used when the thread starts and
+ * after every collection. The buffer takes its blocks on the next allocation.
  */
-void Allocator_InitCursors(Allocator *allocator) {
+void Allocator_InitTlab(Allocator *allocator, Tlab *tlab) {
+    tlab->cursor = NULL;
+    tlab->limit = NULL;
+    tlab->unrecorded = NULL;
+    tlab->block = NULL;
+    tlab->largeBlock = NULL;
+    tlab->largeCursor = NULL;
+    tlab->largeLimit = NULL;
+    BlockList_Init(&tlab->sweptBlocks, allocator->heapStart);
+    tlab->allocatedBytes = 0;
+    tlab->holeEnd = NULL;
+    tlab->untilSample = Profiler_NextInterval(&profiler);
+}
 
-    // Init cursor
-    allocator->block = NULL;
-    allocator->cursor = NULL;
-    allocator->limit = NULL;
+/**
+ * Sets the bump limit to the end of the hole, or to the next sample if it
+ * comes first.
+ */
+void Allocator_setLimit(Tlab *tlab, word_t *holeEnd) {
+    tlab->holeEnd = holeEnd;
+    size_t holeSize = (ubyte_t *)holeEnd - (ubyte_t *)tlab->unrecorded;
+    if (tlab->untilSample < holeSize) {
+        tlab->limit =
+            (word_t *)((ubyte_t *)tlab->unrecorded + tlab->untilSample);
+    } else {
+        tlab->limit = holeEnd;
+    }
+}
 
-    Allocator_getNextLine(allocator);
+/**
+ * Zeroes a hole before the thread bump allocates into it, so that allocations
+ * only write the headers of the objects. The word after the last object of
+ * the hole then reads as an empty header for the heap walks.
+ */
+static inline void Allocator_zeroHole(word_t *start, word_t *end) {
+    memset(start, 0, (ubyte_t *)end - (ubyte_t *)start);
+}
 
-    // Init large cursor
-    assert(!BlockList_IsEmpty(&allocator->freeBlocks));
+/**
+ * Counts `size` allocated bytes towards the next sample.
+ */
+static inline void Allocator_countTowardsSample(Tlab *tlab, size_t size) {
+    tlab->untilSample = size < tlab->untilSample ? tlab->untilSample - size : 0;
+}
 
-    BlockHeader *largeHeader =
-        BlockList_RemoveFirstBlock(&allocator->freeBlocks);
-    allocator->largeBlock = largeHeader;
-    allocator->largeCursor = Block_GetFirstWord(largeHeader);
-    allocator->largeLimit = Block_GetBlockEnd(largeHeader);
+/**
+ * Counts the free, recyclable and unavailable blocks right after a sweep.
+ *
+ * With lazy sweeping the heap is not swept yet, so the free blocks are the
+ * ones without any marked object, and the unavailable blocks are estimated
+ * from the number of marked lines.
+ */
+void Allocator_CountBlocks(Allocator *allocator, uint64_t *freeBlockCount,
+                           uint64_t *recycledBlockCount,
+                           uint64_t *unavailableBlockCount) {
+    if (allocator->lazySweep) {
+        *freeBlockCount = allocator->blockCount - allocator->markedBlockCount;
+        *unavailableBlockCount = allocator->markedLineCount / LINE_COUNT;
+        *recycledBlockCount = 0;
+        if (allocator->markedBlockCount > *unavailableBlockCount) {
+            *recycledBlockCount =
+                allocator->markedBlockCount - *unavailableBlockCount;
+        }
+    } else {
+        *freeBlockCount = allocator->freeBlockCount;
+        *recycledBlockCount = allocator->recycledBlockCount;
+        *unavailableBlockCount =
+            allocator->blockCount -
+            (allocator->freeBlockCount + allocator->recycledBlockCount);
+    }
 }
 
 /**
  * Heuristic that tells if the heap should be grown or not.
  */
 bool Allocator_ShouldGrow(Allocator *allocator) {
-    uint64_t unavailableBlockCount =
-        allocator->blockCount -
-        (allocator->freeBlockCount + allocator->recycledBlockCount);
+    uint64_t freeBlockCount;
+    uint64_t recycledBlockCount;
+    uint64_t unavailableBlockCount;
+    Allocator_CountBlocks(allocator, &freeBlockCount, &recycledBlockCount,
+                          &unavailableBlockCount);
 
 #ifdef DEBUG_PRINT
     printf("\n\nBlock count: %llu\n", allocator->blockCount);
     printf("Unavailable: %llu\n", unavailableBlockCount);
-    printf("Free: %llu\n", allocator->freeBlockCount);
-    printf("Recycled: %llu\n", allocator->recycledBlockCount);
+    printf("Free: %llu\n", freeBlockCount);
+    printf("Recycled: %llu\n", recycledBlockCount);
     fflush(stdout);
 #endif
 
-    return allocator->freeBlockCount * 2 < allocator->blockCount ||
+    return freeBlockCount * 2 < allocator->blockCount ||
            4 * unavailableBlockCount > allocator->blockCount;
 }
 
 /**
- * Overflow allocation uses only free blocks, it is used when the bump limit of
- * the fast allocator is too small to fit
- * the block to alloc.
+ * Takes a free block from the allocator, sweeping lazily if needed. The
+ * recyclable blocks swept on the way are kept in the thread's buffer.
+ */
+BlockHeader *Allocator_getFreeBlock(Allocator *allocator, Tlab *tlab) {
+    BlockHeader *block = BlockList_RemoveFirstBlock(&allocator->freeBlocks);
+    if (block != NULL) {
+        __atomic_sub_fetch(&allocator->freeBlockCount, 1, __ATOMIC_RELAXED);
+        return block;
+    }
+    while ((block = Allocator_sweepNextBlock(allocator)) != NULL) {
+        if (Block_IsFree(block)) {
+            return block;
+        } else if (Block_IsRecyclable(block)) {
+            BlockList_AddLast(&tlab->sweptBlocks, block);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Takes a recyclable block from the allocator, from the smallest class from
+ * `minClass` up that has one.
+ */
+BlockHeader *Allocator_getRecycledBlock(Allocator *allocator, int minClass) {
+    for (int i = minClass; i < RECYCLED_BLOCK_CLASSES; i++) {
+        BlockHeader *block =
+            BlockList_RemoveFirstBlock(&allocator->recycledBlocks[i]);
+        if (block != NULL) {
+            __atomic_sub_fetch(&allocator->recycledBlockCount, 1,
+                               __ATOMIC_RELAXED);
+            return block;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Moves the overflow allocation to the first hole of the recyclable `block`
+ * with at least `lines` lines, and takes it out of the holes of the block.
+ *
+ * @return `true` if the block had such a hole, `false` otherwise.
+ */
+bool Allocator_takeMediumHole(Tlab *tlab, BlockHeader *block, uint32_t lines) {
+    int16_t *previous = &block->header.first;
+    while (*previous != LAST_HOLE) {
+        word_t *line = Block_GetLineAddress(block, *previous);
+        FreeLineHeader *lineHeader = (FreeLineHeader *)line;
+        if (lineHeader->size >= lines) {
+            *previous = lineHeader->next;
+            tlab->largeBlock = block;
+            tlab->largeCursor = line;
+            tlab->largeLimit = line + (lineHeader->size * WORDS_IN_LINE);
+            Allocator_zeroHole(tlab->largeCursor, tlab->largeLimit);
+            return true;
+        }
+        previous = &lineHeader->next;
+    }
+    return false;
+}
+
+/**
+ * Overflow allocation is used for the medium objects that do not fit in the
+ * hole of the fast allocator. It allocates into holes of at least the size of
+ * the object: the other holes of the recyclable block it uses, then those of
+ * a recyclable block whose largest hole fits the object, and only then a free
+ * block. The holes left in a recyclable block once none of them fits go to
+ * the small objects of the thread.
  */
-word_t *Allocator_overflowAllocation(Allocator *allocator, size_t size) {
-    word_t *start = allocator->largeCursor;
+word_t *Allocator_overflowAllocation(Allocator *allocator, Tlab *tlab,
+                                     size_t size) {
+    word_t *start = tlab->largeCursor;
     word_t *end = (word_t *)((uint8_t *)start + size);
 
-    if (end > allocator->largeLimit) {
-        if (BlockList_IsEmpty(&allocator->freeBlocks)) {
+    if (end > tlab->largeLimit) {
+        uint32_t lines = (uint32_t)MathUtils_DivAndRoundUp(size, LINE_SIZE);
+        BlockHeader *block = tlab->largeBlock;
+        if (block != NULL && Block_IsRecyclable(block)) {
+            if (Allocator_takeMediumHole(tlab, block, lines)) {
+                return Allocator_overflowAllocation(allocator, tlab, size);
+            }
+            if (block->header.first != LAST_HOLE) {
+                BlockList_AddLast(&tlab->sweptBlocks, block);
+            }
+            tlab->largeBlock = NULL;
+            tlab->largeCursor = NULL;
+            tlab->largeLimit = NULL;
+        }
+        // Any block of these classes has a hole of at least `lines` lines
+        block = Allocator_getRecycledBlock(allocator,
+                                           MathUtils_Log2Ceil(lines));
+        if (block != NULL) {
+            Allocator_takeMediumHole(tlab, block, lines);
+            return Allocator_overflowAllocation(allocator, tlab, size);
+        }
+        block = Allocator_getFreeBlock(allocator, tlab);
+        if (block == NULL) {
             return NULL;
         }
-        BlockHeader *block = BlockList_RemoveFirstBlock(&allocator->freeBlocks);
-        allocator->largeBlock = block;
-        allocator->largeCursor = Block_GetFirstWord(block);
-        allocator->largeLimit = Block_GetBlockEnd(block);
-        return Allocator_overflowAllocation(allocator, size);
+        tlab->largeBlock = block;
+        tlab->largeCursor = Block_GetFirstWord(block);
+        tlab->largeLimit = Block_GetBlockEnd(block);
+        Allocator_zeroHole(tlab->largeCursor, tlab->largeLimit);
+        return Allocator_overflowAllocation(allocator, tlab, size);
     }
 
-    if (end == allocator->largeLimit) {
-        memset(start, 0, size);
-    } else {
-        memset(start, 0, size + WORD_SIZE);
+    tlab->largeCursor = end;
+    tlab->allocatedBytes += size;
+    Allocator_countTowardsSample(tlab, size);
+    if (tlab->holeEnd != NULL) {
+        Allocator_setLimit(tlab, tlab->holeEnd);
     }
 
-    allocator->largeCursor = end;
-
-    Line_Update(allocator->largeBlock, start);
+    Line_Update(tlab->largeBlock, start);
+    Block_SetObjectStart(tlab->largeBlock, start);
 
     return start;
 }
 
 /**
- * Allocation fast path, uses the cursor and limit.
+ * Allocation fast path, uses the cursor of the thread's buffer and the end of
+ * its hole. The limit can stop short of the hole, see `Allocator_setLimit`.
  */
-INLINE word_t *Allocator_Alloc(Allocator *allocator, size_t size) {
-    word_t *start = allocator->cursor;
+INLINE word_t *Allocator_Alloc(Allocator *allocator, Tlab *tlab, size_t size) {
+    word_t *start = tlab->cursor;
     word_t *end = (word_t *)((uint8_t *)start + size);
 
-    // Checks if the end of the block overlaps with the limit
-    if (end > allocator->limit) {
+    // Checks if the end of the block overlaps with the end of the hole
+    if (end > tlab->holeEnd) {
         // If it overlaps but the block to allocate is a `medium` sized block,
         // use overflow allocation
         if (size > LINE_SIZE) {
-            return Allocator_overflowAllocation(allocator, size);
+            return Allocator_overflowAllocation(allocator, tlab, size);
         } else {
             // Otherwise try to get a new line.
-            if (Allocator_getNextLine(allocator)) {
-                return Allocator_Alloc(allocator, size);
+            if (Allocator_getNextLine(allocator, tlab)) {
+                return Allocator_Alloc(allocator, tlab, size);
             }
 
             return NULL;
         }
     }
 
-    if (end == allocator->limit) {
-        memset(start, 0, size);
-    } else {
-        memset(start, 0, size + WORD_SIZE);
-    }
+    tlab->cursor = end;
 
-    allocator->cursor = end;
+    return start;
+}
 
-    Line_Update(allocator->block, start);
+/**
+ * Records the objects the buffer bump allocated since it took its hole, in the
+ * start bitmap of the block, and the first object of every line in the header
+ * of the line.
+ */
+void Allocator_RecordObjects(Tlab *tlab) {
+    word_t *current = tlab->unrecorded;
+    word_t *cursor = tlab->cursor;
+    if (current < cursor) {
+        size_t size = (ubyte_t *)cursor - (ubyte_t *)current;
+        tlab->allocatedBytes += size;
+        Allocator_countTowardsSample(tlab, size);
+    }
+    while (current < cursor) {
+        Line_Update(tlab->block, current);
+        word_t *nextLine = (word_t *)(((word_t)current | LINE_SIZE_MASK) + 1);
+        do {
+            Block_SetObjectStart(tlab->block, current);
+            current += Object_Size(&((Object *)current)->header) / WORD_SIZE;
+        } while (current < cursor && current < nextLine);
+    }
+    tlab->unrecorded = cursor;
+}
 
-    return start;
+/**
+ * Called on the slow path before an allocation of `size` bytes, tells if it is
+ * the one to sample. The limit of the buffer is then moved to the sample after
+ * it.
+ */
+bool Allocator_SampleAllocation(Tlab *tlab, size_t size) {
+    if (!profiler.enabled) {
+        return false;
+    }
+    Allocator_RecordObjects(tlab);
+    if (size < tlab->untilSample) {
+        return false;
+    }
+    tlab->untilSample = size + Profiler_NextInterval(&profiler);
+    if (tlab->holeEnd != NULL) {
+        Allocator_setLimit(tlab, tlab->holeEnd);
+    }
+    return true;
 }
 
 /**
- * Updates the cursor and the limit of the Allocator to point the next line of
+ * Updates the cursor and the limit of the buffer to point the next line of
  * the recycled block
  */
-bool Allocator_nextLineRecycled(Allocator *allocator) {
+bool Allocator_nextLineRecycled(Allocator *allocator, Tlab *tlab) {
     // The cursor can point on first word of next block, thus `- WORD_SIZE`
-    BlockHeader *block = Block_GetBlockHeader(allocator->cursor - WORD_SIZE);
+    BlockHeader *block = Block_GetBlockHeader(tlab->cursor - WORD_SIZE);
     assert(Block_IsRecyclable(block));
 
     int16_t lineIndex = block->header.first;
     if (lineIndex == LAST_HOLE) {
-        allocator->cursor = NULL;
-        return Allocator_getNextLine(allocator);
+        // The limit goes too, the allocation is retried if no block is left
+        tlab->cursor = NULL;
+        tlab->limit = NULL;
+        tlab->holeEnd = NULL;
+        return Allocator_getNextLine(allocator, tlab);
     }
 
     word_t *line = Block_GetLineAddress(block, lineIndex);
 
-    allocator->cursor = line;
+    tlab->cursor = line;
+    tlab->unrecorded = line;
     FreeLineHeader *lineHeader = (FreeLineHeader *)line;
     block->header.first = lineHeader->next;
     uint16_t size = lineHeader->size;
-    allocator->limit = line + (size * WORDS_IN_LINE);
+    Allocator_zeroHole(line, line + (size * WORDS_IN_LINE));
+    Allocator_setLimit(tlab, line + (size * WORDS_IN_LINE));
 
     return true;
 }
 
 /**
- * Updates the the cursor and the limit of the Allocator to point to the first
+ * Updates the the cursor and the limit of the buffer to point to the first
  * free line of the new block.
  */
-void Allocator_firstLineNewBlock(Allocator *allocator, BlockHeader *block) {
-    allocator->block = block;
+void Allocator_firstLineNewBlock(Tlab *tlab, BlockHeader *block) {
+    tlab->block = block;
 
     // The block can be free or recycled.
     if (Block_IsFree(block)) {
-        allocator->cursor = Block_GetFirstWord(block);
-        allocator->limit = Block_GetBlockEnd(block);
+        tlab->cursor = Block_GetFirstWord(block);
+        tlab->unrecorded = tlab->cursor;
+        Allocator_zeroHole(tlab->cursor, Block_GetBlockEnd(block));
+        Allocator_setLimit(tlab, Block_GetBlockEnd(block));
     } else {
         assert(Block_IsRecyclable(block));
         int16_t lineIndex = block->header.first;
         assert(lineIndex < LINE_COUNT);
         word_t *line = Block_GetLineAddress(block, lineIndex);
 
-        allocator->cursor = line;
+        tlab->cursor = line;
         FreeLineHeader *lineHeader = (FreeLineHeader *)line;
         block->header.first = lineHeader->next;
         uint16_t size = lineHeader->size;
         assert(size > 0);
-        allocator->limit = line + (size * WORDS_IN_LINE);
+        tlab->unrecorded = line;
+        Allocator_zeroHole(line, line + (size * WORDS_IN_LINE));
+        Allocator_setLimit(tlab, line + (size * WORDS_IN_LINE));
     }
 }
 
-bool Allocator_getNextLine(Allocator *allocator) {
+bool Allocator_getNextLine(Allocator *allocator, Tlab *tlab) {
+    Allocator_RecordObjects(tlab);
     // If cursor is null or the block was free, we need a new block
-    if (allocator->cursor == NULL ||
+    if (tlab->cursor == NULL ||
         // The cursor can point on first word of next block, thus `- WORD_SIZE`
-        Block_IsFree(Block_GetBlockHeader(allocator->cursor - WORD_SIZE))) {
+        Block_IsFree(Block_GetBlockHeader(tlab->cursor - WORD_SIZE))) {
         // request the new block.
-        BlockHeader *block = Allocator_getNextBlock(allocator);
+        BlockHeader *block = Allocator_getNextBlock(allocator, tlab);
         // return false if there is no block left.
         if (block == NULL) {
             return false;
         }
 
-        Allocator_firstLineNewBlock(allocator, block);
+        Allocator_firstLineNewBlock(tlab, block);
 
         return true;
 
     } else {
         // If we have a recycled block
-        return Allocator_nextLineRecycled(allocator);
+        return Allocator_nextLineRecycled(allocator, tlab);
     }
 }
 
+bool Allocator_HasUnsweptBlocks(Allocator *allocator) {
+    return __atomic_load_n(&allocator->sweepCursor, __ATOMIC_RELAXED) !=
+           allocator->sweepLimit;
+}
+
 /**
- * Returns a block, first from recycled if available, otherwise from
- * chunk_allocator
+ * Adds the blocks and counters of a sweep to the allocator.
  */
-BlockHeader *Allocator_getNextBlock(Allocator *allocator) {
-    BlockHeader *block = NULL;
-    if (!BlockList_IsEmpty(&allocator->recycledBlocks)) {
-        block = BlockList_RemoveFirstBlock(&allocator->recycledBlocks);
-    } else if (!BlockList_IsEmpty(&allocator->freeBlocks)) {
-        block = BlockList_RemoveFirstBlock(&allocator->freeBlocks);
+void Allocator_AddSweepResult(Allocator *allocator, SweepResult *result) {
+    for (int i = 0; i < RECYCLED_BLOCK_CLASSES; i++) {
+        BlockList *recycled = &result->recycledBlocks[i];
+        if (!BlockList_IsEmpty(recycled)) {
+            BlockList_AddBlocksLast(&allocator->recycledBlocks[i],
+                                    recycled->first, recycled->last);
+        }
+    }
+    if (!BlockList_IsEmpty(&result->freeBlocks)) {
+        BlockList_AddBlocksLast(&allocator->freeBlocks,
+                                result->freeBlocks.first,
+                                result->freeBlocks.last);
     }
+    allocator->recycledBlockCount += result->recycledBlockCount;
+    allocator->freeBlockCount += result->freeBlockCount;
+    allocator->freeMemoryAfterCollection += result->freeMemory;
+}
+
+/**
+ * Lazily sweeps the next block that was marked by the last collection. The
+ * block is handed to the calling thread instead of being added to the lists,
+ * which only shrink while the program runs.
+ *
+ * @return the swept block, or `NULL` if there is no block left to sweep
+ */
+BlockHeader *Allocator_sweepNextBlock(Allocator *allocator) {
+    word_t *current =
+        __atomic_load_n(&allocator->sweepCursor, __ATOMIC_RELAXED);
+    do {
+        if (current == allocator->sweepLimit) {
+            return NULL;
+        }
+    } while (!__atomic_compare_exchange_n(&allocator->sweepCursor, &current,
+                                          current + WORDS_IN_BLOCK, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    BlockHeader *block = (BlockHeader *)current;
+
+    SweepResult result;
+    Block_InitSweepResult(&result, allocator->heapStart);
+    // Lazy sweeping is not used with sticky marks
+    Block_Recycle(&result, block, false);
+    __atomic_add_fetch(&allocator->freeMemoryAfterCollection,
+                       result.freeMemory, __ATOMIC_RELAXED);
     return block;
 }
+
+/**
+ * Returns a block, first from recycled if available, otherwise from
+ * chunk_allocator. The recycled blocks with the smallest holes go first, the
+ * larger holes are kept for medium objects. With lazy sweeping, blocks are
+ * swept until one of them can be used. The block counts only keep track of
+ * the blocks left in the lists.
+ */
+BlockHeader *Allocator_getNextBlock(Allocator *allocator, Tlab *tlab) {
+    BlockHeader *block = BlockList_RemoveFirstBlock(&tlab->sweptBlocks);
+    if (block != NULL) {
+        return block;
+    }
+    block = Allocator_getRecycledBlock(allocator, 0);
+    if (block != NULL) {
+        return block;
+    }
+    block = BlockList_RemoveFirstBlock(&allocator->freeBlocks);
+    if (block != NULL) {
+        __atomic_sub_fetch(&allocator->freeBlockCount, 1, __ATOMIC_RELAXED);
+        return block;
+    }
+    while ((block = Allocator_sweepNextBlock(allocator)) != NULL) {
+        if (Block_IsFree(block) || Block_IsRecyclable(block)) {
+            return block;
+        }
+    }
+    return NULL;
+}
@@ -5,27 +5,90 @@
 #include <stddef.h>
 #include "datastructures/BlockList.h"
 
+/**
+ * Blocks and counters collected while sweeping a part of the small heap. Every
+ * GC thread fills its own `SweepResult`, they are merged into the `Allocator`
+ * with `Allocator_AddSweepResult`.
+ */
 typedef struct {
-    word_t *heapStart;
-    uint64_t blockCount;
-    BlockList recycledBlocks;
+    // By the size of their largest hole, see `Block_RecycledClass`
+    BlockList recycledBlocks[RECYCLED_BLOCK_CLASSES];
     uint64_t recycledBlockCount;
     BlockList freeBlocks;
     uint64_t freeBlockCount;
-    BlockHeader *block;
+    size_t freeMemory;
+} SweepResult;
+
+/**
+ * Thread-local allocation buffer of a mutator thread: the block it bump
+ * allocates into and the free block it uses for overflow allocation. Only the
+ * owning thread touches it, the blocks come from the `Allocator`.
+ *
+ * The bump allocation fast path, also inlined by the compiler, leaves the line
+ * headers alone. The objects from `unrecorded` to `cursor` are recorded in
+ * them before the buffer moves to another hole and before collections, see
+ * `Allocator_RecordObjects`. When the allocation profiler is enabled, `limit`
+ * is moved down to the next sample so that the fast path misses on it.
+ */
+typedef struct {
+    // The compiler relies on `cursor` and `limit` coming first
     word_t *cursor;
     word_t *limit;
+    word_t *unrecorded;
+    BlockHeader *block;
     BlockHeader *largeBlock;
     word_t *largeCursor;
     word_t *largeLimit;
+    // Recyclable blocks left to the small objects: swept lazily while looking
+    // for a free block, or given up by overflow allocation with holes left
+    BlockList sweptBlocks;
+    // Bytes allocated since the world was last stopped, see `GCStats`
+    uint64_t allocatedBytes;
+    // End of the current hole, `limit` stops short of it before a sample
+    word_t *holeEnd;
+    // Bytes from `unrecorded` to the next allocation sample, see `Profiler`
+    size_t untilSample;
+} Tlab;
+
+/**
+ * Pool of the small heap blocks. While the program runs, the mutator threads
+ * take blocks out of the lists without locking, blocks are only added back
+ * while the world is stopped.
+ */
+typedef struct {
+    word_t *heapStart;
+    uint64_t blockCount;
+    // By the size of their largest hole, see `Block_RecycledClass`
+    BlockList recycledBlocks[RECYCLED_BLOCK_CLASSES];
+    uint64_t recycledBlockCount;
+    BlockList freeBlocks;
+    uint64_t freeBlockCount;
+    // Blocks returned to the OS, they are not counted in `blockCount`
+    BlockList decommittedBlocks;
+    uint64_t decommittedBlockCount;
     size_t freeMemoryAfterCollection;
+    // Lazy sweeping: the blocks from `sweepCursor` to `sweepLimit` were
+    // marked by the last collection and are swept on demand
+    bool lazySweep;
+    word_t *sweepCursor;
+    word_t *sweepLimit;
+    // Number of blocks and lines marked by the last collection
+    uint64_t markedBlockCount;
+    uint64_t markedLineCount;
 } Allocator;
 
 void Allocator_Init(Allocator *allocator, word_t *, int);
 bool Allocator_CanInitCursors(Allocator *allocator);
-void Allocator_InitCursors(Allocator *allocator);
-word_t *Allocator_Alloc(Allocator *allocator, size_t size);
+void Allocator_InitTlab(Allocator *allocator, Tlab *tlab);
+word_t *Allocator_Alloc(Allocator *allocator, Tlab *tlab, size_t size);
+void Allocator_RecordObjects(Tlab *tlab);
+bool Allocator_SampleAllocation(Tlab *tlab, size_t size);
+void Allocator_AddSweepResult(Allocator *allocator, SweepResult *result);
+bool Allocator_HasUnsweptBlocks(Allocator *allocator);
 
+void Allocator_CountBlocks(Allocator *allocator, uint64_t *freeBlockCount,
+                           uint64_t *recycledBlockCount,
+                           uint64_t *unavailableBlockCount);
 bool Allocator_ShouldGrow(Allocator *allocator);
 
 #endif // IMMIX_ALLOCATOR_H
@@ -5,62 +5,78 @@
 #include "Log.h"
 #include "Allocator.h"
 #include "Marker.h"
+#include "utils/MemoryUtils.h"
 
 extern int __object_array_id;
 
 #define NO_RECYCLABLE_LINE -1
 
-INLINE void Block_recycleUnmarkedBlock(Allocator *allocator,
+void Block_InitSweepResult(SweepResult *result, word_t *heapStart) {
+    for (int i = 0; i < RECYCLED_BLOCK_CLASSES; i++) {
+        BlockList_Init(&result->recycledBlocks[i], heapStart);
+    }
+    BlockList_Init(&result->freeBlocks, heapStart);
+    result->recycledBlockCount = 0;
+    result->freeBlockCount = 0;
+    result->freeMemory = 0;
+}
+
+INLINE void Block_recycleUnmarkedBlock(SweepResult *result,
                                        BlockHeader *blockHeader) {
-    memset(blockHeader, 0, LINE_SIZE);
-    BlockList_AddLast(&allocator->freeBlocks, blockHeader);
+    memset(blockHeader, 0, sizeof(BlockHeader));
+    BlockList_AddLast(&result->freeBlocks, blockHeader);
     Block_SetFlag(blockHeader, block_free);
 }
 
+/**
+ * Frees the objects of a marked line that were not marked, by clearing their
+ * start bits. Only the bitmaps are touched, not the objects.
+ */
 INLINE void Block_recycleMarkedLine(BlockHeader *blockHeader,
-                                    LineHeader *lineHeader, int lineIndex) {
-    Line_Unmark(lineHeader);
-    // If the line contains an object
-    if (Line_ContainsObject(lineHeader)) {
-        // Unmark all objects in line
-        Object *object = Line_GetFirstObject(lineHeader);
-        word_t *lineEnd =
-            Block_GetLineAddress(blockHeader, lineIndex) + WORDS_IN_LINE;
-        while (object != NULL && (word_t *)object < lineEnd) {
-            ObjectHeader *objectHeader = &object->header;
-            if (Object_IsMarked(objectHeader)) {
-                Object_SetAllocated(objectHeader);
-            } else {
-                Object_SetFree(objectHeader);
-            }
-            object = Object_NextObject(object);
-        }
+                                    LineHeader *lineHeader, int lineIndex,
+                                    bool stickyMarks) {
+    blockHeader->startBits[lineIndex] &= blockHeader->markBits[lineIndex];
+    if (!stickyMarks) {
+        Line_Unmark(lineHeader);
+        blockHeader->markBits[lineIndex] = 0;
     }
 }
 
 /**
- * recycles a block and adds it to the allocator
+ * recycles a block and adds it to the sweep result. With `stickyMarks`, the
+ * block, its lines and its objects that survive stay marked.
  */
-void Block_Recycle(Allocator *allocator, BlockHeader *blockHeader) {
+void Block_Recycle(SweepResult *result, BlockHeader *blockHeader,
+                   bool stickyMarks) {
+    // Out of the heap, see `Block_Decommit`
+    if (Block_IsDecommitted(blockHeader)) {
+        return;
+    }
 
     // If the block is not marked, it means that it's completely free
     if (!Block_IsMarked(blockHeader)) {
-        Block_recycleUnmarkedBlock(allocator, blockHeader);
-        allocator->freeBlockCount++;
-        allocator->freeMemoryAfterCollection += BLOCK_TOTAL_SIZE;
+        Block_recycleUnmarkedBlock(result, blockHeader);
+        result->freeBlockCount++;
+        result->freeMemory += BLOCK_TOTAL_SIZE;
     } else {
         // If the block is marked, we need to recycle line by line
         assert(Block_IsMarked(blockHeader));
-        Block_Unmark(blockHeader);
+        if (!stickyMarks) {
+            Block_Unmark(blockHeader);
+        }
+        blockHeader->header.evacuate = 0;
         int16_t lineIndex = 0;
         int lastRecyclable = NO_RECYCLABLE_LINE;
+        uint8_t freeLineCount = 0;
+        uint8_t largestHole = 0;
         while (lineIndex < LINE_COUNT) {
             LineHeader *lineHeader =
                 Block_GetLineHeader(blockHeader, lineIndex);
-            // If the line is marked, we need to unmark all objects in the line
+            // If the line is marked, its unmarked objects are freed
             if (Line_IsMarked(lineHeader)) {
                 // Unmark line
-                Block_recycleMarkedLine(blockHeader, lineHeader, lineIndex);
+                Block_recycleMarkedLine(blockHeader, lineHeader, lineIndex,
+                                        stickyMarks);
                 lineIndex++;
             } else {
                 // If the line is not marked, we need to merge all continuous
@@ -77,22 +93,29 @@ void Block_Recycle(Allocator *allocator, BlockHeader *blockHeader) {
                         lineIndex;
                 }
                 lastRecyclable = lineIndex;
-                lineIndex++;
                 Line_SetEmpty(lineHeader);
-                allocator->freeMemoryAfterCollection += LINE_SIZE;
+                blockHeader->startBits[lineIndex] = 0;
+                lineIndex++;
+                result->freeMemory += LINE_SIZE;
                 uint8_t size = 1;
                 while (lineIndex < LINE_COUNT &&
                        !Line_IsMarked(lineHeader = Block_GetLineHeader(
                                           blockHeader, lineIndex))) {
+                    Line_SetEmpty(lineHeader);
+                    blockHeader->startBits[lineIndex] = 0;
                     size++;
                     lineIndex++;
-                    Line_SetEmpty(lineHeader);
-                    allocator->freeMemoryAfterCollection += LINE_SIZE;
+                    result->freeMemory += LINE_SIZE;
                 }
                 Block_GetFreeLineHeader(blockHeader, lastRecyclable)->size =
                     size;
+                freeLineCount += size;
+                if (size > largestHole) {
+                    largestHole = size;
+                }
             }
         }
+        blockHeader->header.freeLineCount = freeLineCount;
         // If there is no recyclable line, the block is unavailable
         if (lastRecyclable == NO_RECYCLABLE_LINE) {
             Block_SetFlag(blockHeader, block_unavailable);
@@ -100,18 +123,54 @@ void Block_Recycle(Allocator *allocator, BlockHeader *blockHeader) {
             Block_GetFreeLineHeader(blockHeader, lastRecyclable)->next =
                 LAST_HOLE;
             Block_SetFlag(blockHeader, block_recyclable);
-            BlockList_AddLast(&allocator->recycledBlocks, blockHeader);
+            BlockList_AddLast(
+                &result->recycledBlocks[Block_RecycledClass(largestHole)],
+                blockHeader);
 
             assert(blockHeader->header.first != NO_RECYCLABLE_LINE);
-            allocator->recycledBlockCount++;
+            result->recycledBlockCount++;
         }
     }
 }
 
+/**
+ * Unmarks a block, its lines and its objects, so that the next mark traces
+ * them again. Used before full collections when marks are sticky.
+ */
+void Block_ClearMarks(BlockHeader *blockHeader) {
+    if (!Block_IsMarked(blockHeader)) {
+        return;
+    }
+    Block_Unmark(blockHeader);
+    for (int lineIndex = 0; lineIndex < (int)LINE_COUNT; lineIndex++) {
+        LineHeader *lineHeader = Block_GetLineHeader(blockHeader, lineIndex);
+        Line_ClearDirty(lineHeader);
+        Line_Unmark(lineHeader);
+    }
+    memset(blockHeader->markBits, 0, sizeof(blockHeader->markBits));
+}
+
+/**
+ * Returns the lines of a free block to the OS. The metadata stays, so that the
+ * block can be kept in a block list and skipped by the sweep. The block stays
+ * free if the OS refused.
+ */
+bool Block_Decommit(BlockHeader *blockHeader) {
+    assert(Block_IsFree(blockHeader));
+    if (!MemoryUtils_Decommit(Block_GetFirstWord(blockHeader),
+                              Block_GetBlockEnd(blockHeader))) {
+        return false;
+    }
+    Block_SetFlag(blockHeader, block_decommitted);
+    return true;
+}
+
 void Block_Print(BlockHeader *block) {
     printf("%p ", block);
     if (Block_IsFree(block)) {
         printf("FREE\n");
+    } else if (Block_IsDecommitted(block)) {
+        printf("DECOMMITTED\n");
     } else if (Block_IsUnavailable(block)) {
         printf("UNAVAILABLE\n");
     } else {
@@ -7,6 +7,21 @@
 
 #define LAST_HOLE -1
 
-void Block_Recycle(Allocator *, BlockHeader *);
+/**
+ * Class of the recyclable blocks whose largest hole has `lines` lines, see
+ * `RECYCLED_BLOCK_CLASSES`.
+ */
+static inline int Block_RecycledClass(uint32_t lines) {
+    int blockClass = MathUtils_LastSetBit(lines);
+    if (blockClass >= RECYCLED_BLOCK_CLASSES) {
+        return RECYCLED_BLOCK_CLASSES - 1;
+    }
+    return blockClass;
+}
+
+void Block_InitSweepResult(SweepResult *result, word_t *heapStart);
+void Block_Recycle(SweepResult *, BlockHeader *, bool stickyMarks);
+void Block_ClearMarks(BlockHeader *blockHeader);
+bool Block_Decommit(BlockHeader *blockHeader);
 void Block_Print(BlockHeader *block);
 #endif // IMMIX_BLOCK_H
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "ConcurrentMarker.h"
+#include "Marker.h"
+#include "Object.h"
+#include "State.h"
+#include "WriteBarrier.h"
+#include "Log.h"
+
+// Read by the code generated for reference stores
+bool __write_barrier_active = false;
+
+void Marker_markObject(Heap *heap, Stack *stack, Object *object);
+
+void ConcurrentMarker_markBuffer(Heap *heap, Stack *stack, LogBuffer *buffer) {
+    for (uint32_t i = 0; i < buffer->count; i++) {
+        Object *object = buffer->objects[i];
+        if (!Object_IsMarked(object)) {
+            Marker_markObject(heap, stack, object);
+        }
+    }
+}
+
+/**
+ * Traces from the marker's stack and the logged objects, until there is no
+ * work left or the collector asks to stop.
+ */
+void ConcurrentMarker_trace(ConcurrentMarker *marker, Heap *heap) {
+    Stack *stack = &marker->stack;
+    while (!__atomic_load_n(&marker->stop, __ATOMIC_RELAXED)) {
+        Stack_Type entry;
+        if (Stack_Pop(stack, &entry)) {
+            Marker_ScanEntry(heap, stack, &entry);
+            continue;
+        }
+        LogBuffer *buffer = WriteBarrier_TakeBuffer();
+        if (buffer == NULL) {
+            return;
+        }
+        ConcurrentMarker_markBuffer(heap, stack, buffer);
+        WriteBarrier_ReleaseBuffer(buffer);
+    }
+}
+
+void *ConcurrentMarker_loop(void *arg) {
+    ConcurrentMarker *marker = (ConcurrentMarker *)arg;
+
+    pthread_mutex_lock(&marker->lock);
+    while (true) {
+        while (marker->phase != concurrent_marking) {
+            pthread_cond_wait(&marker->start, &marker->lock);
+        }
+        pthread_mutex_unlock(&marker->lock);
+
+        ConcurrentMarker_trace(marker, &heap);
+        Object_TakeMarkedCounts(&allocator.markedBlockCount,
+                                &allocator.markedLineCount);
+
+        pthread_mutex_lock(&marker->lock);
+        // The collector finishes the cycle at its next safe point
+        __atomic_store_n(&marker->phase, concurrent_done, __ATOMIC_RELEASE);
+        pthread_cond_signal(&marker->parked);
+    }
+    return NULL;
+}
+
+void ConcurrentMarker_Init(ConcurrentMarker *marker, bool incremental) {
+    marker->incremental = incremental;
+    marker->rate = 0;
+    marker->phase = concurrent_idle;
+    marker->stop = false;
+    pthread_mutex_init(&marker->lock, NULL);
+    pthread_cond_init(&marker->start, NULL);
+    pthread_cond_init(&marker->parked, NULL);
+    Stack_Init(&marker->stack, INITIAL_STACK_SIZE);
+
+    if (incremental) {
+        marker->enabled = true;
+        return;
+    }
+    marker->enabled = pthread_create(&marker->thread, NULL,
+                                     ConcurrentMarker_loop, marker) == 0;
+    if (marker->enabled) {
+        pthread_detach(marker->thread);
+    }
+}
+
+/**
+ * Rate of the incremental slices for the cycle that starts. The cycle traces
+ * at most the used memory, and should be done by the time the program has
+ * allocated `1 / INCREMENTAL_MARK_PACING` of the free memory. The free lines
+ * of the recyclable blocks are not counted, they might be few.
+ */
+double ConcurrentMarker_sliceRate() {
+    uint64_t freeBlockCount = allocator.freeBlockCount;
+    if (freeBlockCount == 0) {
+        freeBlockCount = 1;
+    }
+    uint64_t usedBytes =
+        (allocator.blockCount - allocator.freeBlockCount) * BLOCK_TOTAL_SIZE +
+        largeAllocator.liveSize;
+    return INCREMENTAL_MARK_PACING * usedBytes /
+           (freeBlockCount * BLOCK_TOTAL_SIZE);
+}
+
+/**
+ * Starts a concurrent cycle: pushes the roots to the marker's stack, enables
+ * the write barrier and wakes up the marker thread.
+ */
+void ConcurrentMarker_Start(ConcurrentMarker *marker, Heap *heap) {
+    assert(marker->phase == concurrent_idle);
+    allocator.markedBlockCount = 0;
+    allocator.markedLineCount = 0;
+    marker->rate = ConcurrentMarker_sliceRate();
+
+    Marker_ScanRoots(heap, &marker->stack);
+    __write_barrier_active = true;
+
+    pthread_mutex_lock(&marker->lock);
+    marker->phase = concurrent_marking;
+    pthread_cond_signal(&marker->start);
+    pthread_mutex_unlock(&marker->lock);
+}
+
+/**
+ * Ends the concurrent cycle. Once this returns the heap is marked and ready
+ * to be swept.
+ */
+void ConcurrentMarker_Finish(ConcurrentMarker *marker, Heap *heap) {
+    assert(ConcurrentMarker_IsMarking(marker));
+
+    pthread_mutex_lock(&marker->lock);
+    __atomic_store_n(&marker->stop, true, __ATOMIC_RELAXED);
+    // Slices only run in critical regions, none is left once the world is
+    // stopped
+    while (!marker->incremental && marker->phase != concurrent_done) {
+        pthread_cond_wait(&marker->parked, &marker->lock);
+    }
+    marker->stop = false;
+    marker->phase = concurrent_idle;
+    pthread_mutex_unlock(&marker->lock);
+
+    __write_barrier_active = false;
+
+    // Hand what the marker did not trace yet over to the GC threads. If it
+    // does not fit, the objects are already marked and the overflow handler
+    // finds them.
+    Stack_Type entry;
+    while (Stack_Pop(&marker->stack, &entry)) {
+        if (!overflow &&
+            Stack_Push(&stacks[0], entry.object, entry.start)) {
+            overflow = true;
+        }
+    }
+    // Only the marker thread used its stack
+    Stack_ReleaseRetired(&marker->stack);
+
+    // The mutator threads are stopped outside of their critical regions
+    for (MutatorThread *thread = mutatorThreads.first; thread != NULL;
+         thread = thread->next) {
+        WriteBarrier_Flush(&thread->logBuffer);
+    }
+    LogBuffer *buffer;
+    while ((buffer = WriteBarrier_TakeBuffer()) != NULL) {
+        ConcurrentMarker_markBuffer(heap, &stacks[0], buffer);
+        WriteBarrier_ReleaseBuffer(buffer);
+    }
+
+    Marker_MarkParallel(heap);
+}
+
+/**
+ * Traces `allocatedBytes` times the rate of the cycle, in incremental mode.
+ * Called by a mutator thread in a critical region, after it allocated that
+ * much, so that the cycle is done before the heap is full. The slices of the
+ * threads do not overlap, a thread skips its slice while another one traces.
+ * Only the objects logged by the other threads are left for the final pause.
+ * The last slice leaves the cycle for the next allocation slow path to
+ * finish, with the world stopped.
+ */
+void ConcurrentMarker_Slice(ConcurrentMarker *marker, Heap *heap,
+                            size_t allocatedBytes) {
+    if (!marker->incremental ||
+        __atomic_load_n(&marker->phase, __ATOMIC_ACQUIRE) !=
+            concurrent_marking ||
+        pthread_mutex_trylock(&marker->lock) != 0) {
+        return;
+    }
+    Stack *stack = &marker->stack;
+    double budget = allocatedBytes * marker->rate;
+    while (marker->phase == concurrent_marking && budget > 0) {
+        Stack_Type entry;
+        if (Stack_Pop(stack, &entry)) {
+            // A slice scans at most a chunk of an array
+            size_t size = Object_Size(&entry.object->header);
+            if (size > ARRAY_CHUNK_SIZE * WORD_SIZE) {
+                size = ARRAY_CHUNK_SIZE * WORD_SIZE;
+            }
+            budget -= size;
+            Marker_ScanEntry(heap, stack, &entry);
+            continue;
+        }
+        LogBuffer *buffer = WriteBarrier_TakeBuffer();
+        if (buffer != NULL) {
+            budget -= buffer->count * WORD_SIZE;
+            ConcurrentMarker_markBuffer(heap, stack, buffer);
+            WriteBarrier_ReleaseBuffer(buffer);
+            continue;
+        }
+        // The buffer of the calling thread is not full yet, it is traced now
+        // rather than in the final pause
+        LogBuffer *own = currentMutatorThread->logBuffer;
+        if (own != NULL && own->count > 0) {
+            budget -= own->count * WORD_SIZE;
+            ConcurrentMarker_markBuffer(heap, stack, own);
+            own->count = 0;
+        } else {
+            __atomic_store_n(&marker->phase, concurrent_done,
+                             __ATOMIC_RELEASE);
+        }
+    }
+    Object_TakeMarkedCounts(&allocator.markedBlockCount,
+                            &allocator.markedLineCount);
+    pthread_mutex_unlock(&marker->lock);
+}
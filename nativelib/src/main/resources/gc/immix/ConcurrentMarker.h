@@ -0,0 +1,63 @@
+#ifndef IMMIX_CONCURRENTMARKER_H
+#define IMMIX_CONCURRENTMARKER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include "Heap.h"
+#include "datastructures/Stack.h"
+
+typedef enum {
+    concurrent_idle = 0x0,
+    concurrent_marking = 0x1,
+    concurrent_done = 0x2,
+} ConcurrentPhase;
+
+/**
+ * Background thread that marks the heap while the mutator keeps running.
+ *
+ * A cycle starts with a short pause that pushes the roots and enables the
+ * write barrier. The mutator logs the objects it unlinks from the heap and
+ * allocates black, so that everything that was reachable at the start of the
+ * cycle is marked. The cycle ends with a second pause that traces the logged
+ * objects and what is left of the marker's work with all the GC threads.
+ *
+ * Threads check the barrier flag, log and store in one critical region, so
+ * the first pause never stops a thread between the check and the store.
+ *
+ * In incremental mode, there is no marker thread. The mutator threads trace
+ * in slices instead, on their allocation slow paths, see
+ * `ConcurrentMarker_Slice`.
+ */
+typedef struct {
+    bool enabled;
+    bool incremental;
+    // Bytes traced by incremental slices per byte allocated in this cycle
+    double rate;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t parked;
+    Stack stack;
+    ConcurrentPhase phase;
+    bool stop;
+} ConcurrentMarker;
+
+extern bool __write_barrier_active;
+
+void ConcurrentMarker_Init(ConcurrentMarker *marker, bool incremental);
+void ConcurrentMarker_Start(ConcurrentMarker *marker, Heap *heap);
+void ConcurrentMarker_Finish(ConcurrentMarker *marker, Heap *heap);
+void ConcurrentMarker_Slice(ConcurrentMarker *marker, Heap *heap,
+                            size_t allocatedBytes);
+
+static inline bool ConcurrentMarker_IsMarking(ConcurrentMarker *marker) {
+    return __atomic_load_n(&marker->phase, __ATOMIC_RELAXED) !=
+           concurrent_idle;
+}
+
+static inline bool ConcurrentMarker_IsDone(ConcurrentMarker *marker) {
+    return __atomic_load_n(&marker->phase, __ATOMIC_ACQUIRE) ==
+           concurrent_done;
+}
+
+#endif // IMMIX_CONCURRENTMARKER_H
@@ -9,13 +9,14 @@
 #define BLOCK_SIZE_BITS 15
 #define LINE_SIZE_BITS 8
 
-#define BLOCK_METADATA_SIZE_BITS 3
-#define LINE_METADATA_SIZE_BITS 0
+#define BLOCK_METADATA_SIZE_BITS 4
 
 #define BLOCK_TOTAL_SIZE (1 << BLOCK_SIZE_BITS)
 #define BLOCK_METADATA_SIZE (1 << BLOCK_METADATA_SIZE_BITS)
 #define LINE_SIZE (1UL << LINE_SIZE_BITS)
-#define LINE_METADATA_SIZE (1 << LINE_METADATA_SIZE_BITS)
+// The line header, and the 32 bits words of the line in the start and mark
+// bitmaps of the block
+#define LINE_METADATA_SIZE (1 + 2 * 4)
 
 #define LINE_SIZE_MASK (LINE_SIZE - 1)
 
@@ -52,8 +53,66 @@
 #define EARLY_GROWTH_THRESHOLD (128 * 1024 * 1024UL)
 #define EARLY_GROWTH_RATE 2.0
 #define GROWTH_RATE 1.414213562
+// Free blocks are returned to the OS when more than this part of the small heap
+// is free after a collection, see `Heap_shrink`
+#define SHRINK_THRESHOLD 0.75
+// Free blocks kept per used block when the small heap shrinks, and free bytes
+// kept per live byte when the large heap returns its free runs to the OS
+#define SHRINK_HEADROOM 2
+
+// Targets of the adaptive sizing policy: share of the time spent in pauses
+#define DEFAULT_GC_TIME_RATIO 0.05
+// Weight of the last cycle in the measurements of the sizing policy
+#define SIZING_POLICY_WEIGHT 0.5
+// The adaptive sizing policy changes the heap size by at most this factor,
+// and keeps at least this share of it free
+#define SIZING_POLICY_MAX_STEP 2.0
+#define SIZING_POLICY_MIN_FREE 0.2
+
+// Number of fields of an object array scanned at once by the marker
+#define ARRAY_CHUNK_SIZE 1024
+
+// Heaps backed by huge pages start and grow at multiples of it
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024UL)
 
 #define INITIAL_SMALL_HEAP_SIZE (4 * 1024 * 1024UL)
 #define INITIAL_LARGE_HEAP_SIZE (1024 * 1024UL)
+#define DEFAULT_LARGE_HEAP_RATIO                                               \
+    ((double)INITIAL_LARGE_HEAP_SIZE /                                         \
+     (INITIAL_SMALL_HEAP_SIZE + INITIAL_LARGE_HEAP_SIZE))
+
+#define DEFAULT_MAX_GC_THREADS 8
+#define MAX_GC_THREADS 64
+// Number of blocks a GC thread sweeps at a time
+#define SWEEP_BATCH_BLOCKS 64
+// Fraction of free and recyclable blocks under which a concurrent mark starts
+#define CONCURRENT_MARK_THRESHOLD 0.25
+// Incremental marking aims at being done once this share of the free memory
+// at the start of the cycle is allocated
+#define INCREMENTAL_MARK_PACING 2.0
+// Fraction of the small heap a minor collection has to free, otherwise a full
+// collection follows
+#define MINOR_COLLECTION_MIN_FREE 0.25
+// Fraction of the blocks kept free for the objects moved by evacuation
+#define EVACUATION_RESERVE 0.025
+// Blocks with more live lines than this are never evacuated
+#define EVACUATION_MAX_LIVE_LINES (LINE_COUNT / 2)
+// Classes of the recyclable blocks, class `n` holds the blocks whose largest
+// hole has from 2^n to 2^(n+1) - 1 lines, the last one the larger holes too
+#define RECYCLED_BLOCK_CLASSES 7
+// Number of events the GC trace keeps, a power of 2
+#define TRACE_CAPACITY 4096
+// Mean number of bytes between two allocation samples
+#define DEFAULT_PROFILER_INTERVAL (512 * 1024UL)
+// Frames kept from the stack of a sampled allocation
+#define PROFILER_MAX_FRAMES 48
+// Initial number of entries of the profiler, a power of 2
+#define PROFILER_INITIAL_CAPACITY 1024
+// Longest class name written by the profiler and the heap dumps
+#define CLASS_NAME_MAX_LENGTH 1024
+// Initial number of classes of a heap dump, a power of 2
+#define HEAP_DUMP_INITIAL_CAPACITY 1024
+// Bytes buffered by a heap dump between two writes to its file
+#define HEAP_DUMP_BUFFER_SIZE (64 * 1024)
 
 #endif // IMMIX_CONSTANTS_H
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <string.h>
+#include "Evacuation.h"
+#include "Block.h"
+#include "Line.h"
+#include "Log.h"
+
+// Bump allocation cursor of the calling GC thread in an evacuation block
+static __thread word_t *cursor = NULL;
+static __thread word_t *limit = NULL;
+static __thread uint64_t cursorEpoch = 0;
+
+void Evacuation_Init(Evacuation *evacuation, word_t *heapStart) {
+    evacuation->enabled = true;
+    evacuation->active = false;
+    evacuation->epoch = 0;
+    pthread_mutex_init(&evacuation->lock, NULL);
+    BlockList_Init(&evacuation->blocks, heapStart);
+    evacuation->blockCount = 0;
+}
+
+/**
+ * Takes the blocks for the next evacuation from the free blocks of a fresh
+ * sweep, leaving the allocator enough to initialize its cursors. Blocks left
+ * over by the last evacuation were swept as free blocks already.
+ */
+void Evacuation_ReserveBlocks(Evacuation *evacuation, Allocator *allocator) {
+    BlockList_Clear(&evacuation->blocks);
+    evacuation->blockCount = 0;
+
+    uint64_t count = (uint64_t)(allocator->blockCount * EVACUATION_RESERVE);
+    if (count == 0) {
+        count = 1;
+    }
+    while (evacuation->blockCount < count && allocator->freeBlockCount > 2) {
+        BlockHeader *block = BlockList_RemoveFirstBlock(&allocator->freeBlocks);
+        allocator->freeBlockCount--;
+        BlockList_AddLast(&evacuation->blocks, block);
+        evacuation->blockCount++;
+    }
+}
+
+/**
+ * Marks the recyclable blocks with the fewest live lines as candidates, as
+ * many as the reserved blocks can take in.
+ */
+void Evacuation_SelectCandidates(Evacuation *evacuation, Heap *heap) {
+    if (!evacuation->enabled || evacuation->blockCount == 0) {
+        return;
+    }
+
+    // Number of recyclable blocks by live line count
+    uint64_t histogram[LINE_COUNT + 1] = {0};
+    for (word_t *current = heap->heapStart; current < heap->heapEnd;
+         current += WORDS_IN_BLOCK) {
+        BlockHeader *block = (BlockHeader *)current;
+        if (Block_IsRecyclable(block)) {
+            histogram[LINE_COUNT - block->header.freeLineCount]++;
+        }
+    }
+
+    uint64_t available = evacuation->blockCount * LINE_COUNT;
+    uint64_t required = 0;
+    int threshold = 0;
+    for (int live = 1; live <= (int)EVACUATION_MAX_LIVE_LINES; live++) {
+        required += histogram[live] * live;
+        if (required > available) {
+            break;
+        }
+        threshold = live;
+    }
+    if (threshold == 0) {
+        return;
+    }
+
+    for (word_t *current = heap->heapStart; current < heap->heapEnd;
+         current += WORDS_IN_BLOCK) {
+        BlockHeader *block = (BlockHeader *)current;
+        if (Block_IsRecyclable(block) &&
+            (int)(LINE_COUNT - block->header.freeLineCount) <= threshold) {
+            block->header.evacuate = 1;
+        }
+    }
+    evacuation->epoch++;
+    evacuation->active = true;
+}
+
+/**
+ * Called once marking is over. The candidates are reset by the sweep.
+ */
+void Evacuation_Finish(Evacuation *evacuation) { evacuation->active = false; }
+
+BlockHeader *Evacuation_takeBlock(Evacuation *evacuation) {
+    if (__atomic_load_n(&evacuation->blockCount, __ATOMIC_RELAXED) == 0) {
+        return NULL;
+    }
+    BlockHeader *block = NULL;
+    pthread_mutex_lock(&evacuation->lock);
+    if (evacuation->blockCount > 0) {
+        block = BlockList_RemoveFirstBlock(&evacuation->blocks);
+        evacuation->blockCount--;
+    }
+    pthread_mutex_unlock(&evacuation->lock);
+    return block;
+}
+
+/**
+ * Allocates `size` bytes for a moved object on the calling GC thread.
+ *
+ * @return `NULL` once the reserved blocks are used up
+ */
+word_t *Evacuation_Allocate(Evacuation *evacuation, size_t size) {
+    if (cursorEpoch != evacuation->epoch) {
+        cursorEpoch = evacuation->epoch;
+        cursor = NULL;
+        limit = NULL;
+    }
+
+    word_t *start = cursor;
+    word_t *end = (word_t *)((ubyte_t *)start + size);
+    if (start == NULL || end > limit) {
+        BlockHeader *block = Evacuation_takeBlock(evacuation);
+        if (block == NULL) {
+            cursor = NULL;
+            limit = NULL;
+            return NULL;
+        }
+        start = Block_GetFirstWord(block);
+        end = (word_t *)((ubyte_t *)start + size);
+        limit = Block_GetBlockEnd(block);
+        // Ends the objects of the block for the heap walks
+        memset(start, 0, (ubyte_t *)limit - (ubyte_t *)start);
+    }
+    cursor = end;
+
+    BlockHeader *blockHeader = Block_GetBlockHeader(start);
+    Line_Update(blockHeader, start);
+    Block_SetObjectStart(blockHeader, start);
+    return start;
+}
@@ -0,0 +1,41 @@
+#ifndef IMMIX_EVACUATION_H
+#define IMMIX_EVACUATION_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include "Heap.h"
+#include "datastructures/BlockList.h"
+
+/**
+ * Opportunistic evacuation of the small heap.
+ *
+ * Every sweep withholds a few free blocks from the allocator. The next full
+ * mark picks the recyclable blocks with the fewest live lines, as counted by
+ * the last sweep, as candidates, and the GC threads copy the objects they
+ * reach through precise references out of them into the withheld blocks.
+ * Objects reached from the conservatively scanned stack are marked before
+ * tracing starts, so they stay in place, and so do objects whose address was
+ * observed. Once the withheld blocks are full, objects are marked in place.
+ */
+typedef struct {
+    bool enabled;
+    // Set while the current mark moves objects out of candidate blocks
+    bool active;
+    // Incremented by every evacuating mark, resets the GC threads' cursors
+    uint64_t epoch;
+    pthread_mutex_t lock;
+    BlockList blocks;
+    uint64_t blockCount;
+} Evacuation;
+
+void Evacuation_Init(Evacuation *evacuation, word_t *heapStart);
+void Evacuation_ReserveBlocks(Evacuation *evacuation, Allocator *allocator);
+void Evacuation_SelectCandidates(Evacuation *evacuation, Heap *heap);
+void Evacuation_Finish(Evacuation *evacuation);
+word_t *Evacuation_Allocate(Evacuation *evacuation, size_t size);
+
+static inline bool Evacuation_IsActive(Evacuation *evacuation) {
+    return evacuation->active;
+}
+
+#endif // IMMIX_EVACUATION_H
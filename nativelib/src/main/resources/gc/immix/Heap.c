@@ -6,11 +6,17 @@
 #include "Log.h"
 #include "Allocator.h"
 #include "Marker.h"
+#include "Object.h"
 #include "State.h"
 #include "utils/MathUtils.h"
 #include "StackTrace.h"
 #include "Memory.h"
+#include "ConcurrentMarker.h"
+#include "MutatorThreads.h"
+#include "HeapDump.h"
 #include <memory.h>
+#include <string.h>
+#include <limits.h>
 
 // Allow read and write
 #define HEAP_MEM_PROT (PROT_READ | PROT_WRITE)
@@ -20,40 +26,169 @@
 #define HEAP_MEM_FD -1
 #define HEAP_MEM_FD_OFFSET 0
 
-size_t Heap_getMemoryLimit() { return getMemorySize(); }
+void Heap_finishLazySweep(Heap *heap);
+bool Heap_isConcurrentMarkDue();
+void Heap_pollConcurrentMark(Heap *heap);
+void Heap_sweepAll(Heap *heap);
+void Heap_clearMarks(Heap *heap);
+void Heap_markRoots(Heap *heap, Stack *stacks);
+void Heap_initTlabs();
+void Heap_exitWithOutOfMemory();
+void Heap_shrink(Heap *heap, uint64_t targetBlockCount);
+void Heap_addBlocks(Heap *heap, size_t increment);
 
 /**
- * Maps `MAX_SIZE` of memory and returns the first address aligned on
- * `alignement` mask
+ * Reads the memory limit of a cgroup from `path`, which holds either a number
+ * of bytes or `max`.
+ *
+ * @return the limit, or `0` if there is none
  */
-word_t *Heap_mapAndAlign(size_t memoryLimit, size_t alignmentSize) {
-    word_t *heapStart = mmap(NULL, memoryLimit, HEAP_MEM_PROT, HEAP_MEM_FLAGS,
-                             HEAP_MEM_FD, HEAP_MEM_FD_OFFSET);
+size_t Heap_readCgroupLimit(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    unsigned long long limit = 0;
+    if (fscanf(file, "%llu", &limit) != 1) {
+        limit = 0;
+    }
+    fclose(file);
+    return (size_t)limit;
+}
 
-    size_t alignmentMask = ~(alignmentSize - 1);
-    // Heap start not aligned on
-    if (((word_t)heapStart & alignmentMask) != (word_t)heapStart) {
-        word_t *previousBlock =
-            (word_t *)((word_t)heapStart & BLOCK_SIZE_IN_BYTES_INVERSE_MASK);
-        heapStart = previousBlock + WORDS_IN_BLOCK;
+/**
+ * The memory limit of the cgroup of the process, for cgroups v2 and v1. Each
+ * line of `/proc/self/cgroup` holds a hierarchy, its controllers and the path
+ * of the cgroup in it, the hierarchy of cgroups v2 has no controllers.
+ *
+ * @return the limit, or `0` if there is none
+ */
+size_t Heap_getCgroupMemoryLimit() {
+#ifdef __linux__
+    FILE *file = fopen("/proc/self/cgroup", "r");
+    if (file == NULL) {
+        return 0;
     }
-    return heapStart;
+    size_t limit = 0;
+    char line[PATH_MAX];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        char *controllers = strchr(line, ':');
+        char *cgroup = NULL;
+        if (controllers != NULL) {
+            cgroup = strchr(controllers + 1, ':');
+        }
+        if (cgroup == NULL) {
+            continue;
+        }
+        *cgroup++ = '\0';
+        controllers++;
+        char path[PATH_MAX + 64];
+        if (*controllers == '\0') {
+            snprintf(path, sizeof(path), "/sys/fs/cgroup%s/memory.max", cgroup);
+        } else if (strstr(controllers, "memory") != NULL) {
+            snprintf(path, sizeof(path),
+                     "/sys/fs/cgroup/memory%s/memory.limit_in_bytes", cgroup);
+        } else {
+            continue;
+        }
+        size_t cgroupLimit = Heap_readCgroupLimit(path);
+        if (cgroupLimit != 0 && (limit == 0 || cgroupLimit < limit)) {
+            limit = cgroupLimit;
+        }
+    }
+    fclose(file);
+    return limit;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * The physical memory, or the memory limit of the cgroup of the process if it
+ * is lower.
+ */
+size_t Heap_GetMemoryLimit() {
+    size_t limit = getMemorySize();
+    size_t cgroupLimit = Heap_getCgroupMemoryLimit();
+    // Without a limit, cgroups v1 reports a huge number
+    if (cgroupLimit != 0 && cgroupLimit < limit) {
+        limit = cgroupLimit;
+    }
+    return limit;
+}
+
+/**
+ * Maps `memoryLimit` of memory and returns the first address aligned on
+ * `alignmentSize`. One more alignment unit is mapped, as the heap can reach
+ * the limit.
+ *
+ * With `huge_pages_hugetlb`, the memory is taken from the pool of huge pages.
+ * It is not mapped with `MAP_NORESERVE`, so that the mapping fails right away
+ * if the pool cannot back all of it, instead of the program being killed
+ * once the pool runs out. The heap then falls back to transparent huge pages,
+ * and `hugePages` is updated.
+ */
+word_t *Heap_mapAndAlign(size_t memoryLimit, size_t alignmentSize,
+                         HugePages *hugePages) {
+    size_t size = memoryLimit + alignmentSize;
+    word_t *heapStart = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (*hugePages == huge_pages_hugetlb) {
+        size = MathUtils_RoundToNextMultiple(size, HUGE_PAGE_SIZE);
+        heapStart = mmap(NULL, size, HEAP_MEM_PROT,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                         HEAP_MEM_FD, HEAP_MEM_FD_OFFSET);
+    }
+#endif
+    if (heapStart == MAP_FAILED) {
+        if (*hugePages == huge_pages_hugetlb) {
+            *hugePages = huge_pages_transparent;
+        }
+        heapStart = mmap(NULL, size, HEAP_MEM_PROT, HEAP_MEM_FLAGS,
+                         HEAP_MEM_FD, HEAP_MEM_FD_OFFSET);
+        if (heapStart == MAP_FAILED) {
+            printf("Out of address space for the heap\n");
+            exit(1);
+        }
+#ifdef MADV_HUGEPAGE
+        if (*hugePages == huge_pages_transparent) {
+            // Pages are only backed by huge pages once touched
+            madvise(heapStart, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    word_t aligned =
+        MathUtils_RoundToNextMultiple((word_t)heapStart, alignmentSize);
+    return (word_t *)aligned;
 }
 
 /**
  * Allocates the heap struct and initializes it
  */
 void Heap_Init(Heap *heap, size_t initialSmallHeapSize,
-               size_t initialLargeHeapSize) {
+               size_t initialLargeHeapSize, size_t memoryLimit,
+               HugePages hugePages) {
     assert(initialSmallHeapSize >= 2 * BLOCK_TOTAL_SIZE);
     assert(initialSmallHeapSize % BLOCK_TOTAL_SIZE == 0);
     assert(initialLargeHeapSize >= 2 * BLOCK_TOTAL_SIZE);
     assert(initialLargeHeapSize % BLOCK_TOTAL_SIZE == 0);
 
-    size_t memoryLimit = Heap_getMemoryLimit();
     heap->memoryLimit = memoryLimit;
-
-    word_t *smallHeapStart = Heap_mapAndAlign(memoryLimit, BLOCK_TOTAL_SIZE);
+    heap->earlyGrowthRate = EARLY_GROWTH_RATE;
+    heap->growthRate = GROWTH_RATE;
+    heap->minSmallHeapSize = initialSmallHeapSize;
+
+    size_t smallAlignment = BLOCK_TOTAL_SIZE;
+    size_t largeAlignment = MIN_BLOCK_SIZE;
+    if (hugePages != huge_pages_none) {
+        smallAlignment = HUGE_PAGE_SIZE;
+        largeAlignment = HUGE_PAGE_SIZE;
+    }
+    // Both heaps fall back to transparent huge pages if either of them does
+    word_t *smallHeapStart =
+        Heap_mapAndAlign(memoryLimit, smallAlignment, &hugePages);
 
     // Init heap for small objects
     heap->smallHeapSize = initialSmallHeapSize;
@@ -63,19 +198,45 @@ void Heap_Init(Heap *heap, size_t initialSmallHeapSize,
                    initialSmallHeapSize / BLOCK_TOTAL_SIZE);
 
     // Init heap for large objects
-    word_t *largeHeapStart = Heap_mapAndAlign(memoryLimit, MIN_BLOCK_SIZE);
+    word_t *largeHeapStart =
+        Heap_mapAndAlign(memoryLimit, largeAlignment, &hugePages);
+    heap->hugePages = hugePages;
     heap->largeHeapSize = initialLargeHeapSize;
-    LargeAllocator_Init(&largeAllocator, largeHeapStart, initialLargeHeapSize);
+    LargeAllocator_Init(&largeAllocator, largeHeapStart, initialLargeHeapSize,
+                        hugePages == huge_pages_none);
     heap->largeHeapStart = largeHeapStart;
     heap->largeHeapEnd =
         (word_t *)((ubyte_t *)largeHeapStart + initialLargeHeapSize);
 }
+/**
+ * Objects allocated during a concurrent mark are kept alive by the cycle.
+ */
+static inline void Heap_allocateBlack(Object *object) {
+    if (ConcurrentMarker_IsMarking(&concurrentMarker)) {
+        Object_Mark(object);
+    }
+}
+
+/**
+ * Traces a slice of an incremental mark for the `bytes` the calling thread
+ * allocated, see `ConcurrentMarker_Slice`.
+ */
+static inline void Heap_markSlice(Heap *heap, MutatorThread *thread,
+                                  size_t bytes) {
+    if (concurrentMarker.incremental &&
+        ConcurrentMarker_IsMarking(&concurrentMarker)) {
+        MutatorThread_EnterCritical(thread);
+        ConcurrentMarker_Slice(&concurrentMarker, heap, bytes);
+        MutatorThread_LeaveCritical(thread);
+    }
+}
+
 /**
  * Allocates large objects using the `LargeAllocator`.
  * If allocation fails, because there is not enough memory available, it will
  * trigger a collection of both the small and the large heap.
  */
-word_t *Heap_AllocLarge(Heap *heap, uint32_t objectSize) {
+word_t *Heap_AllocLarge(Heap *heap, Rtti *rtti, uint32_t objectSize) {
 
     // Add header
     uint32_t size = objectSize + OBJECT_HEADER_SIZE;
@@ -83,113 +244,238 @@ word_t *Heap_AllocLarge(Heap *heap, uint32_t objectSize) {
     assert(objectSize % WORD_SIZE == 0);
     assert(size >= MIN_BLOCK_SIZE);
 
+    MutatorThreads_Lock(&mutatorThreads);
+    Heap_pollConcurrentMark(heap);
+
     // Request an object from the `LargeAllocator`
     Object *object = LargeAllocator_GetBlock(&largeAllocator, size);
-    // If the object is not NULL, update it's metadata and return it
-    if (object != NULL) {
-        ObjectHeader *objectHeader = &object->header;
-
-        Object_SetObjectType(objectHeader, object_large);
-        Object_SetSize(objectHeader, size);
-        return Object_ToMutatorAddress(object);
-    } else {
-        // Otherwise collect
-        Heap_Collect(heap, &stack);
+    // If the object is NULL, collect
+    if (object == NULL) {
+        MutatorThreads_StopTheWorld(&mutatorThreads);
+        Heap_Collect(heap, stacks);
 
         // After collection, try to alloc again, if it fails, grow the heap by
         // at least the size of the object we want to alloc
         object = LargeAllocator_GetBlock(&largeAllocator, size);
-        if (object != NULL) {
-            Object_SetObjectType(&object->header, object_large);
-            Object_SetSize(&object->header, size);
-            return Object_ToMutatorAddress(object);
-        } else {
-            Heap_GrowLarge(heap, size);
-
+        if (object == NULL && heap->generational) {
+            // Old large objects are only freed by full collections
+            Heap_CollectFull(heap, stacks);
             object = LargeAllocator_GetBlock(&largeAllocator, size);
-            ObjectHeader *objectHeader = &object->header;
-
-            Object_SetObjectType(objectHeader, object_large);
-            Object_SetSize(objectHeader, size);
-            return Object_ToMutatorAddress(object);
         }
+        if (object == NULL) {
+            Heap_GrowLarge(heap, size / WORD_SIZE);
+            object = LargeAllocator_GetBlock(&largeAllocator, size);
+        }
+        if (object == NULL) {
+            Heap_exitWithOutOfMemory();
+        }
+        MutatorThreads_ResumeTheWorld(&mutatorThreads);
     }
-}
 
-NOINLINE word_t *Heap_allocSmallSlow(Heap *heap, uint32_t size) {
-    Object *object;
-    object = (Object *)Allocator_Alloc(&allocator, size);
-
-    if (object != NULL)
-        goto done;
+    // Update the object's metadata and return it. The rtti is set before the
+    // lock is released, as objects without one are ignored by the collector.
+    ObjectHeader *objectHeader = &object->header;
+    Object_SetObjectType(objectHeader, object_large);
+    Object_SetSize(objectHeader, size);
+    object->rtti = rtti;
+    Heap_allocateBlack(object);
+    stats.allocatedBytes += size;
+    MutatorThreads_Unlock(&mutatorThreads);
+    if (Profiler_SampleLarge(&profiler, size)) {
+        Profiler_Record(&profiler, rtti, size);
+    }
+    Heap_markSlice(heap, currentMutatorThread, size);
+    return Object_ToMutatorAddress(object);
+}
 
-    Heap_Collect(heap, &stack);
-    object = (Object *)Allocator_Alloc(&allocator, size);
+/**
+ * Allocates a small object when the buffer of the thread and the block lists
+ * are exhausted. Collects, or grows the heap if that was not enough, with the
+ * other threads stopped. Called with the lock of the mutator threads held.
+ */
+Object *Heap_allocSmallLocked(Heap *heap, Tlab *tlab, uint32_t size) {
+    // Another thread might have collected in the meantime
+    Object *object = (Object *)Allocator_Alloc(&allocator, tlab, size);
+    if (object != NULL) {
+        return object;
+    }
 
-    if (object != NULL)
-        goto done;
+    MutatorThreads_StopTheWorld(&mutatorThreads);
+    Heap_Collect(heap, stacks);
+    object = (Object *)Allocator_Alloc(&allocator, tlab, size);
+    if (object == NULL) {
+        Heap_Grow(heap, WORDS_IN_BLOCK);
+        object = (Object *)Allocator_Alloc(&allocator, tlab, size);
+    }
+    if (object == NULL) {
+        Heap_exitWithOutOfMemory();
+    }
+    MutatorThreads_ResumeTheWorld(&mutatorThreads);
+    return object;
+}
 
-    Heap_Grow(heap, size);
-    object = (Object *)Allocator_Alloc(&allocator, size);
+/**
+ * Called in the critical region entered by `Heap_AllocSmall`, leaves it.
+ */
+NOINLINE word_t *Heap_allocSmallSlow(Heap *heap, MutatorThread *thread,
+                                     Rtti *rtti, uint32_t size) {
+    // The buffer records the bytes allocated in its last hole
+    uint64_t allocatedBytes = thread->tlab.allocatedBytes;
+    bool sampled = Allocator_SampleAllocation(&thread->tlab, size);
+    Object *object = (Object *)Allocator_Alloc(&allocator, &thread->tlab, size);
+    bool locked = object == NULL;
+
+    if (locked) {
+        // Stopping the world waits for the other threads to leave their
+        // critical regions, thus none of them can wait for the lock in one
+        MutatorThread_LeaveCritical(thread);
+        MutatorThreads_Lock(&mutatorThreads);
+        object = Heap_allocSmallLocked(heap, &thread->tlab, size);
+    }
 
-done:
     assert(object != NULL);
     ObjectHeader *objectHeader = &object->header;
     Object_SetObjectType(objectHeader, object_standard);
     Object_SetSize(objectHeader, size);
     Object_SetAllocated(objectHeader);
+    object->rtti = rtti;
+    Heap_allocateBlack(object);
+
+    if (locked) {
+        MutatorThreads_Unlock(&mutatorThreads);
+    } else {
+        MutatorThread_LeaveCritical(thread);
+    }
+    if (sampled) {
+        Profiler_Record(&profiler, rtti, size);
+    }
+    // The count restarts when the world is stopped
+    if (thread->tlab.allocatedBytes >= allocatedBytes) {
+        allocatedBytes = thread->tlab.allocatedBytes - allocatedBytes;
+    } else {
+        allocatedBytes = thread->tlab.allocatedBytes;
+    }
+    Heap_markSlice(heap, thread, allocatedBytes);
+    if (Heap_isConcurrentMarkDue()) {
+        MutatorThreads_Lock(&mutatorThreads);
+        Heap_pollConcurrentMark(heap);
+        MutatorThreads_Unlock(&mutatorThreads);
+    }
     return Object_ToMutatorAddress(object);
 }
 
-INLINE word_t *Heap_AllocSmall(Heap *heap, uint32_t objectSize) {
+/**
+ * Bump allocates in the buffer of the calling thread, which must be
+ * registered. The buffer is updated in a critical region, so that collections
+ * never see it half way through an allocation.
+ */
+INLINE word_t *Heap_AllocSmall(Heap *heap, Rtti *rtti, uint32_t objectSize) {
     // Add header
     uint32_t size = objectSize + OBJECT_HEADER_SIZE;
 
     assert(objectSize % WORD_SIZE == 0);
     assert(size < MIN_BLOCK_SIZE);
 
-    word_t *start = allocator.cursor;
+    MutatorThread *thread = currentMutatorThread;
+    Tlab *tlab = &thread->tlab;
+    MutatorThread_EnterCritical(thread);
+
+    word_t *start = tlab->cursor;
     word_t *end = (word_t *)((uint8_t *)start + size);
 
     // Checks if the end of the block overlaps with the limit
-    if (end >= allocator.limit) {
-        return Heap_allocSmallSlow(heap, size);
+    if (end >= tlab->limit) {
+        return Heap_allocSmallSlow(heap, thread, rtti, size);
     }
 
-    allocator.cursor = end;
-
-    Line_Update(allocator.block, start);
-
-    memset(start, 0, size + WORD_SIZE);
+    // The hole was zeroed when the buffer took it
+    tlab->cursor = end;
 
     Object *object = (Object *)start;
     ObjectHeader *objectHeader = &object->header;
     Object_SetObjectType(objectHeader, object_standard);
     Object_SetSize(objectHeader, size);
     Object_SetAllocated(objectHeader);
+    object->rtti = rtti;
+    Heap_allocateBlack(object);
+
+    MutatorThread_LeaveCritical(thread);
 
     __builtin_prefetch(object + 36, 0, 3);
 
     return Object_ToMutatorAddress(object);
 }
 
-word_t *Heap_Alloc(Heap *heap, uint32_t objectSize) {
+/**
+ * Slow path of the allocation fast path inlined by the compiler, called in the
+ * critical region it entered once the buffer of the thread is exhausted.
+ */
+word_t *Heap_AllocSmallSlow(Heap *heap, Rtti *rtti, uint32_t objectSize) {
+    uint32_t size = objectSize + OBJECT_HEADER_SIZE;
+    assert(objectSize % WORD_SIZE == 0);
+    assert(size < MIN_BLOCK_SIZE);
+    return Heap_allocSmallSlow(heap, currentMutatorThread, rtti, size);
+}
+
+word_t *Heap_Alloc(Heap *heap, Rtti *rtti, uint32_t objectSize) {
     assert(objectSize % WORD_SIZE == 0);
 
     if (objectSize + OBJECT_HEADER_SIZE >= LARGE_BLOCK_SIZE) {
-        return Heap_AllocLarge(heap, objectSize);
+        return Heap_AllocLarge(heap, rtti, objectSize);
     } else {
-        return Heap_AllocSmall(heap, objectSize);
+        return Heap_AllocSmall(heap, rtti, objectSize);
     }
 }
 
-void Heap_Collect(Heap *heap, Stack *stack) {
+/**
+ * Records the end of the mark phase of a collection that started marking at
+ * `start`.
+ */
+void Heap_markDone(uint64_t start) {
+    stats.markNanos += Stats_Now() - start;
+    Trace_Record(&trace, trace_mark_done, 0, 0);
+}
+
+/**
+ * Collects the heap. The calling thread must hold the lock of the mutator
+ * threads and have stopped the world, see `MutatorThreads_StopTheWorld`.
+ */
+void Heap_Collect(Heap *heap, Stack *stacks) {
 #ifdef DEBUG_PRINT
     printf("\nCollect\n");
     fflush(stdout);
 #endif
-    Marker_MarkRoots(heap, stack);
-    Heap_Recycle(heap);
+    Trace_Record(&trace, trace_collection_start, 0, 0);
+    uint64_t start = Stats_Now();
+    if (ConcurrentMarker_IsMarking(&concurrentMarker)) {
+        // Finish the concurrent cycle instead of starting another one
+        ConcurrentMarker_Finish(&concurrentMarker, heap);
+        Heap_markDone(start);
+        Heap_Recycle(heap);
+    } else if (heap->generational) {
+        // Minor collection, survivors stay marked
+        Marker_MarkYoung(heap, stacks);
+        Heap_markDone(start);
+        Heap_sweepAll(heap);
+        if (allocator.freeMemoryAfterCollection <
+            heap->smallHeapSize * MINOR_COLLECTION_MIN_FREE) {
+            // The old objects fill the heap, collect them as well
+            Heap_CollectFull(heap, stacks);
+        } else {
+            if (evacuation.enabled) {
+                Evacuation_ReserveBlocks(&evacuation, &allocator);
+            }
+            Heap_initTlabs();
+        }
+    } else {
+        // Marking needs the marks of the last collection to be cleared
+        Heap_finishLazySweep(heap);
+        start = Stats_Now();
+        Heap_markRoots(heap, stacks);
+        Heap_markDone(start);
+        Heap_Recycle(heap);
+    }
+    Trace_Record(&trace, trace_collection_end, 0, 0);
 
 #ifdef DEBUG_PRINT
     printf("End collect\n");
@@ -197,35 +483,344 @@ void Heap_Collect(Heap *heap, Stack *stack) {
 #endif
 }
 
-void Heap_Recycle(Heap *heap) {
-    BlockList_Clear(&allocator.recycledBlocks);
+/**
+ * Collects the whole heap, with the world stopped. With sticky marks, the
+ * marks of the old objects are cleared first, so that they are traced again.
+ */
+void Heap_CollectFull(Heap *heap, Stack *stacks) {
+    if (!heap->generational) {
+        Heap_Collect(heap, stacks);
+        return;
+    }
+    Trace_Record(&trace, trace_collection_start, 0, 0);
+    uint64_t start = Stats_Now();
+    Heap_clearMarks(heap);
+    Heap_markRoots(heap, stacks);
+    Heap_markDone(start);
+    Heap_Recycle(heap);
+    Trace_Record(&trace, trace_collection_end, 0, 0);
+}
+
+/**
+ * Collects the whole heap without moving any object, and takes `dump` of the
+ * live objects between the mark and the sweep. The world must be stopped.
+ */
+void Heap_CollectAndDump(Heap *heap, Stack *stacks, HeapDump *dump) {
+    Trace_Record(&trace, trace_collection_start, 0, 0);
+    uint64_t start = Stats_Now();
+    if (ConcurrentMarker_IsMarking(&concurrentMarker)) {
+        // The objects allocated during the cycle are marked as well, they
+        // are reported as live
+        ConcurrentMarker_Finish(&concurrentMarker, heap);
+    } else {
+        if (heap->generational) {
+            Heap_clearMarks(heap);
+        } else {
+            Heap_finishLazySweep(heap);
+            start = Stats_Now();
+        }
+        Marker_MarkRoots(heap, stacks);
+    }
+    Heap_markDone(start);
+    HeapDump_Take(dump, heap);
+    Heap_Recycle(heap);
+    Trace_Record(&trace, trace_collection_end, 0, 0);
+}
+
+/**
+ * Marks the whole heap from the roots, moving objects out of the sparsest
+ * blocks when evacuation is enabled.
+ */
+void Heap_markRoots(Heap *heap, Stack *stacks) {
+    Evacuation_SelectCandidates(&evacuation, heap);
+    Marker_MarkRoots(heap, stacks);
+    Evacuation_Finish(&evacuation);
+}
+
+/**
+ * Whether a concurrent cycle should start, once the free and recyclable blocks
+ * run low, or finish, once the marker thread ran out of work.
+ */
+bool Heap_isConcurrentMarkDue() {
+    if (!concurrentMarker.enabled) {
+        return false;
+    }
+    return ConcurrentMarker_IsDone(&concurrentMarker) ||
+           (!ConcurrentMarker_IsMarking(&concurrentMarker) &&
+            allocator.freeBlockCount + allocator.recycledBlockCount <
+                allocator.blockCount * CONCURRENT_MARK_THRESHOLD);
+}
+
+/**
+ * Called on the allocation slow paths, with the lock of the mutator threads
+ * held. Starts or finishes a concurrent cycle with the world stopped.
+ */
+void Heap_pollConcurrentMark(Heap *heap) {
+    if (!Heap_isConcurrentMarkDue()) {
+        return;
+    }
+    MutatorThreads_StopTheWorld(&mutatorThreads);
+    uint64_t start = Stats_Now();
+    if (ConcurrentMarker_IsDone(&concurrentMarker)) {
+        Trace_Record(&trace, trace_collection_start, 0, 0);
+        ConcurrentMarker_Finish(&concurrentMarker, heap);
+        Heap_markDone(start);
+        Heap_Recycle(heap);
+        Trace_Record(&trace, trace_collection_end, 0, 0);
+    } else {
+        ConcurrentMarker_Start(&concurrentMarker, heap);
+        stats.markNanos += Stats_Now() - start;
+    }
+    MutatorThreads_ResumeTheWorld(&mutatorThreads);
+}
+
+typedef struct {
+    Heap *heap;
+    // Index of the next batch of blocks to sweep
+    uint64_t nextBlock;
+    uint64_t lastBlock;
+    bool largeHeapClaimed;
+    SweepResult *results;
+} Heap_Sweep;
+
+/**
+ * Claims the next batch of blocks of `sweep`.
+ *
+ * @return `false` once all the blocks are claimed
+ */
+bool Heap_claimBatch(Heap_Sweep *sweep, word_t **start, word_t **end) {
+    uint64_t first = __atomic_fetch_add(&sweep->nextBlock, SWEEP_BATCH_BLOCKS,
+                                        __ATOMIC_RELAXED);
+    if (first >= sweep->lastBlock) {
+        return false;
+    }
+    uint64_t last = first + SWEEP_BATCH_BLOCKS;
+    if (last > sweep->lastBlock) {
+        last = sweep->lastBlock;
+    }
+    *start = sweep->heap->heapStart + first * WORDS_IN_BLOCK;
+    *end = sweep->heap->heapStart + last * WORDS_IN_BLOCK;
+    return true;
+}
+
+/**
+ * Sweeps batches of blocks until all the blocks of the sweep are done. The
+ * first GC thread to get here also sweeps the large heap, unless it is already
+ * claimed.
+ */
+void Heap_sweepWorker(int workerId, void *arg) {
+    Heap_Sweep *sweep = (Heap_Sweep *)arg;
+    SweepResult *result = &sweep->results[workerId];
+    bool stickyMarks = sweep->heap->generational;
+    Block_InitSweepResult(result, sweep->heap->heapStart);
+
+    if (!__atomic_exchange_n(&sweep->largeHeapClaimed, true,
+                             __ATOMIC_ACQ_REL)) {
+        uint64_t start = Stats_Now();
+        LargeAllocator_Sweep(&largeAllocator, stickyMarks);
+        stats.largeSweepNanos += Stats_Now() - start;
+    }
+
+    word_t *current;
+    word_t *end;
+    while (Heap_claimBatch(sweep, &current, &end)) {
+        while (current != end) {
+            BlockHeader *blockHeader = (BlockHeader *)current;
+            Block_Recycle(result, blockHeader, stickyMarks);
+            // block_print(blockHeader);
+            current += WORDS_IN_BLOCK;
+        }
+    }
+}
+
+/**
+ * Clears the sticky marks of batches of blocks, and of the large heap on the
+ * first GC thread to get here.
+ */
+void Heap_clearMarksWorker(int workerId, void *arg) {
+    (void)workerId;
+    Heap_Sweep *sweep = (Heap_Sweep *)arg;
+
+    if (!__atomic_exchange_n(&sweep->largeHeapClaimed, true,
+                             __ATOMIC_ACQ_REL)) {
+        LargeAllocator_ClearMarks(&largeAllocator);
+    }
+
+    word_t *current;
+    word_t *end;
+    while (Heap_claimBatch(sweep, &current, &end)) {
+        for (; current != end; current += WORDS_IN_BLOCK) {
+            Block_ClearMarks((BlockHeader *)current);
+        }
+    }
+}
+
+/**
+ * Unmarks the whole heap with all the GC threads, before a full collection.
+ */
+void Heap_clearMarks(Heap *heap) {
+    Heap_Sweep sweep = {
+        .heap = heap,
+        .nextBlock = 0,
+        .lastBlock = (heap->heapEnd - heap->heapStart) / WORDS_IN_BLOCK,
+        .largeHeapClaimed = false,
+        .results = NULL};
+    WorkerPool_Run(&workerPool, Heap_clearMarksWorker, &sweep);
+}
+
+/**
+ * Sweeps the small heap blocks from `start` to `end` with all the GC threads
+ * and adds them to the allocator.
+ */
+void Heap_sweep(Heap *heap, word_t *start, word_t *end, bool sweepLargeHeap) {
+    SweepResult results[workerPool.count];
+    Heap_Sweep sweep = {
+        .heap = heap,
+        .nextBlock = (start - heap->heapStart) / WORDS_IN_BLOCK,
+        .lastBlock = (end - heap->heapStart) / WORDS_IN_BLOCK,
+        .largeHeapClaimed = !sweepLargeHeap,
+        .results = results};
+    WorkerPool_Run(&workerPool, Heap_sweepWorker, &sweep);
+
+    // Splice the blocks found by every GC thread into the allocator
+    for (int i = 0; i < workerPool.count; i++) {
+        Allocator_AddSweepResult(&allocator, &results[i]);
+    }
+}
+
+/**
+ * Sweeps the blocks that the allocator did not reach since the last
+ * collection.
+ */
+void Heap_finishLazySweep(Heap *heap) {
+    if (Allocator_HasUnsweptBlocks(&allocator)) {
+        uint64_t start = Stats_Now();
+        Heap_sweep(heap, allocator.sweepCursor, allocator.sweepLimit, false);
+        allocator.sweepCursor = allocator.sweepLimit;
+        stats.sweepNanos += Stats_Now() - start;
+    }
+}
+
+/**
+ * Updates the statistics at the end of a collection, once the heap is swept.
+ * The live memory of the small heap is counted in lines, it is estimated from
+ * the marked lines when sweeping lazily.
+ */
+void Heap_recordCollection(Heap *heap) {
+    Trace_Record(&trace, trace_sweep_done, 0, 0);
+    stats.collections++;
+    Allocator_CountBlocks(&allocator, &stats.freeBlocks, &stats.recycledBlocks,
+                          &stats.unavailableBlocks);
+
+    uint64_t liveBytes;
+    if (allocator.lazySweep) {
+        liveBytes = allocator.markedLineCount * LINE_SIZE;
+    } else {
+        uint64_t recycledFreeBytes = allocator.freeMemoryAfterCollection -
+                                     stats.freeBlocks * BLOCK_TOTAL_SIZE;
+        liveBytes = (allocator.blockCount - stats.freeBlocks) * LINE_COUNT *
+                        LINE_SIZE -
+                    recycledFreeBytes;
+    }
+    heap->smallLiveBytes = liveBytes;
+    liveBytes += largeAllocator.liveSize;
+    // Whatever was allocated and did not survive was freed at some point
+    if (stats.allocatedBytes > liveBytes &&
+        stats.allocatedBytes - liveBytes > stats.freedBytes) {
+        stats.freedBytes = stats.allocatedBytes - liveBytes;
+    }
+}
+
+/**
+ * Sweeps the heap, or leaves the small heap to the allocator when sweeping
+ * lazily, and rebuilds the block lists of the allocator.
+ */
+void Heap_sweepAll(Heap *heap) {
+    uint64_t start = Stats_Now();
+    for (int i = 0; i < RECYCLED_BLOCK_CLASSES; i++) {
+        BlockList_Clear(&allocator.recycledBlocks[i]);
+    }
     BlockList_Clear(&allocator.freeBlocks);
 
     allocator.freeBlockCount = 0;
     allocator.recycledBlockCount = 0;
     allocator.freeMemoryAfterCollection = 0;
 
-    word_t *current = heap->heapStart;
-    while (current != heap->heapEnd) {
-        BlockHeader *blockHeader = (BlockHeader *)current;
-        Block_Recycle(&allocator, blockHeader);
-        // block_print(blockHeader);
-        current += WORDS_IN_BLOCK;
+    if (allocator.lazySweep) {
+        // Leave the small heap for the allocator to sweep on demand
+        LargeAllocator_Sweep(&largeAllocator, false);
+        allocator.sweepCursor = heap->heapStart;
+        allocator.sweepLimit = heap->heapEnd;
+        stats.largeSweepNanos += Stats_Now() - start;
+    } else {
+        Heap_sweep(heap, heap->heapStart, heap->heapEnd, true);
     }
-    LargeAllocator_Sweep(&largeAllocator);
+    stats.sweepNanos += Stats_Now() - start;
+    Heap_recordCollection(heap);
+}
 
-    if (Allocator_ShouldGrow(&allocator)) {
-        double growth;
-        if (heap->smallHeapSize < EARLY_GROWTH_THRESHOLD) {
-            growth = EARLY_GROWTH_RATE;
-        } else {
-            growth = GROWTH_RATE;
+/**
+ * Sweeps the heap after a full mark, and grows or shrinks the small heap to
+ * the size chosen by the sizing policy.
+ */
+void Heap_Recycle(Heap *heap) {
+    Heap_sweepAll(heap);
+
+    SizingPolicy_Record(&sizingPolicy, heap);
+    uint64_t targetBlockCount =
+        sizingPolicy.targetBlockCount(&sizingPolicy, heap);
+    if (targetBlockCount > allocator.blockCount) {
+        size_t blocks = targetBlockCount - allocator.blockCount;
+        Heap_Grow(heap, blocks * WORDS_IN_BLOCK);
+    } else if (targetBlockCount < allocator.blockCount &&
+               !allocator.lazySweep) {
+        Heap_shrink(heap, targetBlockCount);
+    }
+    if (evacuation.enabled) {
+        Evacuation_ReserveBlocks(&evacuation, &allocator);
+    }
+    Heap_initTlabs();
+}
+
+/**
+ * Returns free blocks to the OS until the small heap is down to
+ * `targetBlockCount` blocks, or runs out of free blocks. The heap keeps at
+ * least its initial size. With huge pages, blocks are smaller than a page and
+ * the heap does not shrink: transparent huge pages would be split, and
+ * hugetlb pages cannot be returned in parts.
+ */
+void Heap_shrink(Heap *heap, uint64_t targetBlockCount) {
+    if (heap->hugePages != huge_pages_none) {
+        return;
+    }
+    uint64_t minBlockCount = heap->minSmallHeapSize / BLOCK_TOTAL_SIZE;
+    if (targetBlockCount < minBlockCount) {
+        targetBlockCount = minBlockCount;
+    }
+    while (allocator.blockCount > targetBlockCount) {
+        BlockHeader *block = BlockList_RemoveFirstBlock(&allocator.freeBlocks);
+        if (block == NULL) {
+            break;
         }
-        size_t blocks = allocator.blockCount * (growth - 1);
-        size_t increment = blocks * WORDS_IN_BLOCK;
-        Heap_Grow(heap, increment);
+        if (!Block_Decommit(block)) {
+            BlockList_AddLast(&allocator.freeBlocks, block);
+            break;
+        }
+        BlockList_AddLast(&allocator.decommittedBlocks, block);
+        allocator.blockCount--;
+        allocator.freeBlockCount--;
+        allocator.decommittedBlockCount++;
+    }
+}
+
+/**
+ * Empties the allocation buffers of all the threads, their blocks were swept.
+ */
+void Heap_initTlabs() {
+    for (MutatorThread *thread = mutatorThreads.first; thread != NULL;
+         thread = thread->next) {
+        Allocator_InitTlab(&allocator, &thread->tlab);
     }
-    Allocator_InitCursors(&allocator);
 }
 
 void Heap_exitWithOutOfMemory() {
@@ -239,25 +834,92 @@ bool Heap_isGrowingPossible(Heap *heap, size_t increment) {
            heap->memoryLimit;
 }
 
-/** Grows the small heap by at least `increment` words */
+/**
+ * Number of words the heap can still grow by, in multiples of `granularity`
+ * bytes.
+ */
+size_t Heap_availableWords(Heap *heap, size_t granularity) {
+    size_t size = heap->smallHeapSize + heap->largeHeapSize;
+    if (size >= heap->memoryLimit) {
+        return 0;
+    }
+    return (heap->memoryLimit - size) / granularity * granularity / WORD_SIZE;
+}
+
+/**
+ * With huge pages, extends a growth of `increment` words of the heap that
+ * ends at `end` up to the next huge page boundary, so that no huge page is
+ * split between the heap and the memory past its end. The growth stays as is
+ * if it would then exceed the `available` words.
+ */
+size_t Heap_alignGrowth(Heap *heap, word_t *end, size_t increment,
+                        size_t available) {
+    if (heap->hugePages == huge_pages_none) {
+        return increment;
+    }
+    word_t *grownEnd = end + increment;
+    word_t aligned =
+        MathUtils_RoundToNextMultiple((word_t)grownEnd, HUGE_PAGE_SIZE);
+    size_t alignedIncrement = (size_t)((word_t *)aligned - end);
+    return alignedIncrement <= available ? alignedIncrement : increment;
+}
+
+/**
+ * Grows the small heap by at least `increment` words, with the world stopped
+ */
 void Heap_Grow(Heap *heap, size_t increment) {
+    uint64_t from = allocator.blockCount * BLOCK_TOTAL_SIZE;
+    Heap_addBlocks(heap, increment);
+    uint64_t to = allocator.blockCount * BLOCK_TOTAL_SIZE;
+    if (to != from) {
+        Trace_Record(&trace, trace_grow_small_heap, from, to);
+    }
+}
+
+/**
+ * Adds blocks to the allocator for `Heap_Grow`, the decommitted ones first.
+ */
+void Heap_addBlocks(Heap *heap, size_t increment) {
     assert(increment % WORDS_IN_BLOCK == 0);
 
-    // If we cannot grow because we reached the memory limit
+    // The blocks returned to the OS come back first, they are faulted back in
+    // once allocated into
+    while (increment > 0) {
+        BlockHeader *block =
+            BlockList_RemoveFirstBlock(&allocator.decommittedBlocks);
+        if (block == NULL) {
+            break;
+        }
+        Block_SetFlag(block, block_free);
+        BlockList_AddLast(&allocator.freeBlocks, block);
+        allocator.decommittedBlockCount--;
+        allocator.blockCount++;
+        allocator.freeBlockCount++;
+        increment -= WORDS_IN_BLOCK;
+    }
+    if (increment == 0) {
+        return;
+    }
+
+    // Near the memory limit, the heap is collected more often instead, and
+    // only grows once it runs out of free blocks. It then takes half of what
+    // is left, so that the large heap can still grow too. Allocation fails
+    // once nothing fits in the recycled lines either.
     if (!Heap_isGrowingPossible(heap, increment)) {
-        // If we can still init the cursors, grow by max possible increment
         if (Allocator_CanInitCursors(&allocator)) {
-            // increment = heap->memoryLimit - (heap->smallHeapSize +
-            // heap->largeHeapSize);
-            // round down to block size
-            // increment = increment / BLOCK_TOTAL_SIZE * BLOCK_TOTAL_SIZE;
             return;
-        } else {
-            // If the cursors cannot be initialised and we cannot grow, throw
-            // out of memory exception.
-            Heap_exitWithOutOfMemory();
+        }
+        size_t available = Heap_availableWords(heap, BLOCK_TOTAL_SIZE);
+        increment = available / 2 / WORDS_IN_BLOCK * WORDS_IN_BLOCK;
+        if (increment == 0) {
+            increment = available;
+        }
+        if (increment == 0) {
+            return;
         }
     }
+    increment = Heap_alignGrowth(heap, heap->heapEnd, increment,
+                                 Heap_availableWords(heap, BLOCK_TOTAL_SIZE));
 
 #ifdef DEBUG_PRINT
     printf("Growing small heap by %zu bytes, to %zu bytes\n",
@@ -277,26 +939,38 @@ void Heap_Grow(Heap *heap, size_t increment) {
     allocator.freeBlockCount += increment / WORDS_IN_BLOCK;
 }
 
-/** Grows the large heap by at least `increment` words */
+/**
+ * Grows the large heap by at least `increment` words, with the world stopped
+ */
 void Heap_GrowLarge(Heap *heap, size_t increment) {
-    increment = 1UL << MathUtils_Log2Ceil(increment);
-
-    if (heap->smallHeapSize + heap->largeHeapSize + increment * WORD_SIZE >
-        heap->memoryLimit) {
+    increment = MathUtils_RoundToNextMultiple(increment * WORD_SIZE,
+                                              MIN_BLOCK_SIZE) /
+                WORD_SIZE;
+    size_t available = Heap_availableWords(heap, MIN_BLOCK_SIZE);
+    if (increment > available) {
         Heap_exitWithOutOfMemory();
     }
+    // Near the memory limit, grow by what is left
+    size_t doubled = 1UL << MathUtils_Log2Ceil(increment);
+    increment = doubled < available ? doubled : available;
+    increment =
+        Heap_alignGrowth(heap, heap->largeHeapEnd, increment, available);
 #ifdef DEBUG_PRINT
     printf("Growing large heap by %zu bytes, to %zu bytes\n",
            increment * WORD_SIZE, heap->largeHeapSize + increment * WORD_SIZE);
     fflush(stdout);
 #endif
 
+    Trace_Record(&trace, trace_grow_large_heap, heap->largeHeapSize,
+                 heap->largeHeapSize + increment * WORD_SIZE);
     word_t *heapEnd = heap->largeHeapEnd;
     heap->largeHeapEnd += increment;
     heap->largeHeapSize += increment * WORD_SIZE;
     largeAllocator.size += increment * WORD_SIZE;
 
     Bitmap_Grow(largeAllocator.bitmap, increment * WORD_SIZE);
+    Bitmap_Grow(largeAllocator.marks, increment * WORD_SIZE);
+    Bitmap_Grow(largeAllocator.cards, increment * WORD_SIZE);
 
     LargeAllocator_AddChunk(&largeAllocator, (Chunk *)heapEnd,
                             increment * WORD_SIZE);
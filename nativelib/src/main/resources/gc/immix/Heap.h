@@ -6,7 +6,20 @@
 #include "LargeAllocator.h"
 #include "datastructures/Stack.h"
 
+/**
+ * Pages that back the heap. With huge pages, the heap starts and grows at
+ * huge page boundaries.
+ */
+typedef enum {
+    huge_pages_none = 0x0,
+    // Transparent huge pages, requested with `madvise`
+    huge_pages_transparent = 0x1,
+    // Huge pages of the hugetlbfs pool, mapped with `MAP_HUGETLB`
+    huge_pages_hugetlb = 0x2,
+} HugePages;
+
 typedef struct {
+    // The small and large heaps together never grow beyond it
     size_t memoryLimit;
     word_t *heapStart;
     word_t *heapEnd;
@@ -14,6 +27,17 @@ typedef struct {
     word_t *largeHeapStart;
     word_t *largeHeapEnd;
     size_t largeHeapSize;
+    // Marks of surviving objects stick, see `Heap_Collect`
+    bool generational;
+    // Growth factors of the small heap, below and above
+    // `EARLY_GROWTH_THRESHOLD`
+    double earlyGrowthRate;
+    double growthRate;
+    // The small heap does not shrink below it
+    size_t minSmallHeapSize;
+    // Live memory of the small heap after the last sweep, counted in lines
+    uint64_t smallLiveBytes;
+    HugePages hugePages;
 } Heap;
 
 static inline bool Heap_IsWordInLargeHeap(Heap *heap, word_t *word) {
@@ -33,13 +57,17 @@ static inline bool heap_isObjectInHeap(Heap *heap, Object *object) {
     return Heap_IsWordInHeap(heap, (word_t *)object);
 }
 
+size_t Heap_GetMemoryLimit();
 void Heap_Init(Heap *heap, size_t initialSmallHeapSize,
-               size_t initialLargeHeapSize);
-word_t *Heap_Alloc(Heap *heap, uint32_t objectSize);
-word_t *Heap_AllocSmall(Heap *heap, uint32_t objectSize);
-word_t *Heap_AllocLarge(Heap *heap, uint32_t objectSize);
+               size_t initialLargeHeapSize, size_t memoryLimit,
+               HugePages hugePages);
+word_t *Heap_Alloc(Heap *heap, Rtti *rtti, uint32_t objectSize);
+word_t *Heap_AllocSmall(Heap *heap, Rtti *rtti, uint32_t objectSize);
+word_t *Heap_AllocSmallSlow(Heap *heap, Rtti *rtti, uint32_t objectSize);
+word_t *Heap_AllocLarge(Heap *heap, Rtti *rtti, uint32_t objectSize);
 
-void Heap_Collect(Heap *heap, Stack *stack);
+void Heap_Collect(Heap *heap, Stack *stacks);
+void Heap_CollectFull(Heap *heap, Stack *stacks);
 
 void Heap_Recycle(Heap *heap);
 void Heap_Grow(Heap *heap, size_t increment);
@@ -0,0 +1,342 @@
+#include <errno.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "HeapDump.h"
+#include "Block.h"
+#include "Line.h"
+#include "Object.h"
+#include "State.h"
+#include "datastructures/Bitmap.h"
+
+extern int __object_array_id;
+extern word_t *__modules;
+extern int __modules_size;
+
+#define LAST_FIELD_OFFSET -1
+
+// Dumps are taken one at a time, with the world stopped
+static ubyte_t heapDumpBuffer[HEAP_DUMP_BUFFER_SIZE];
+static size_t heapDumpBuffered = 0;
+
+HeapDumpClass *HeapDump_mapClasses(size_t capacity) {
+    // Anonymous mappings read as zeroes, that is empty slots
+    void *classes = mmap(NULL, capacity * sizeof(HeapDumpClass),
+                         PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                         -1, 0);
+    return classes == MAP_FAILED ? NULL : (HeapDumpClass *)classes;
+}
+
+bool HeapDump_Init(HeapDump *dump, int fd) {
+    dump->capacity = HEAP_DUMP_INITIAL_CAPACITY;
+    dump->count = 0;
+    dump->fd = fd;
+    dump->failed = false;
+    dump->classes = HeapDump_mapClasses(dump->capacity);
+    return dump->classes != NULL;
+}
+
+void HeapDump_Free(HeapDump *dump) {
+    munmap(dump->classes, dump->capacity * sizeof(HeapDumpClass));
+    dump->classes = NULL;
+}
+
+/**
+ * Finds the slot of the class, or the empty slot where it goes.
+ */
+HeapDumpClass *HeapDump_find(HeapDumpClass *classes, size_t capacity,
+                             Rtti *rtti) {
+    uint64_t hash = ((uint64_t)rtti >> 3) * 0x9E3779B97F4A7C15ULL;
+    size_t index = (hash >> 32) & (capacity - 1);
+    while (classes[index].rtti != NULL && classes[index].rtti != rtti) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &classes[index];
+}
+
+bool HeapDump_grow(HeapDump *dump) {
+    size_t capacity = dump->capacity * 2;
+    HeapDumpClass *classes = HeapDump_mapClasses(capacity);
+    if (classes == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < dump->capacity; i++) {
+        HeapDumpClass *entry = &dump->classes[i];
+        if (entry->rtti != NULL) {
+            *HeapDump_find(classes, capacity, entry->rtti) = *entry;
+        }
+    }
+    HeapDump_Free(dump);
+    dump->classes = classes;
+    dump->capacity = capacity;
+    return true;
+}
+
+void HeapDump_count(HeapDump *dump, Object *object, size_t size) {
+    if ((dump->count + 1) * 2 > dump->capacity && !HeapDump_grow(dump)) {
+        dump->failed = true;
+        return;
+    }
+    HeapDumpClass *entry =
+        HeapDump_find(dump->classes, dump->capacity, object->rtti);
+    if (entry->rtti == NULL) {
+        entry->rtti = object->rtti;
+        dump->count++;
+    }
+    entry->count++;
+    entry->bytes += size;
+}
+
+void HeapDump_flush(HeapDump *dump) {
+    ubyte_t *current = heapDumpBuffer;
+    ubyte_t *end = heapDumpBuffer + heapDumpBuffered;
+    while (current < end && !dump->failed) {
+        ssize_t written = write(dump->fd, current, end - current);
+        if (written >= 0) {
+            current += written;
+        } else if (errno != EINTR) {
+            dump->failed = true;
+        }
+    }
+    heapDumpBuffered = 0;
+}
+
+void HeapDump_write(HeapDump *dump, void *data, size_t size) {
+    if (heapDumpBuffered + size > HEAP_DUMP_BUFFER_SIZE) {
+        HeapDump_flush(dump);
+    }
+    memcpy(heapDumpBuffer + heapDumpBuffered, data, size);
+    heapDumpBuffered += size;
+}
+
+static inline void HeapDump_writeTag(HeapDump *dump, HeapDumpTag tag) {
+    uint8_t value = (uint8_t)tag;
+    HeapDump_write(dump, &value, sizeof(value));
+}
+
+static inline void HeapDump_writeWord(HeapDump *dump, uint64_t value) {
+    HeapDump_write(dump, &value, sizeof(value));
+}
+
+static inline void HeapDump_writeInt(HeapDump *dump, uint32_t value) {
+    HeapDump_write(dump, &value, sizeof(value));
+}
+
+/**
+ * Writes a root record if `address` points into a live object, looked up as
+ * an inner pointer like the marker does.
+ */
+void HeapDump_writeConservativeRoot(HeapDump *dump, Heap *heap,
+                                    word_t *address) {
+    if (!Heap_IsWordInHeap(heap, address)) {
+        return;
+    }
+    Object *object;
+    if (Heap_IsWordInSmallHeap(heap, address)) {
+        object = Object_GetObject(address);
+    } else {
+        object = Object_GetLargeObject(&largeAllocator, address);
+    }
+    if (object != NULL && Object_IsMarked(object)) {
+        HeapDump_writeTag(dump, heap_dump_root);
+        HeapDump_writeWord(dump, (uint64_t)object);
+    }
+}
+
+void HeapDump_writeRoots(HeapDump *dump, Heap *heap) {
+    // Dumps registers into 'regs' which is on stack
+    jmp_buf regs;
+    setjmp(regs);
+    word_t *dummy;
+
+    MutatorThread *self = currentMutatorThread;
+    for (MutatorThread *thread = mutatorThreads.first; thread != NULL;
+         thread = thread->next) {
+        word_t **top = thread == self ? &dummy : thread->stackTop;
+        for (word_t **current = top; current <= thread->stackBottom;
+             current++) {
+            HeapDump_writeConservativeRoot(dump, heap, *current);
+        }
+    }
+
+    word_t **modules = &__modules;
+    for (int i = 0; i < __modules_size; i++) {
+        Object *object = Object_FromMutatorAddress(modules[i]);
+        if (heap_isObjectInHeap(heap, object)) {
+            HeapDump_writeTag(dump, heap_dump_root);
+            HeapDump_writeWord(dump, (uint64_t)object);
+        }
+    }
+}
+
+static inline Object *HeapDump_reference(Heap *heap, word_t *field) {
+    Object *object = Object_FromMutatorAddress(field);
+    return heap_isObjectInHeap(heap, object) ? object : NULL;
+}
+
+/**
+ * Visits the references of the object, the same fields the marker traces.
+ *
+ * @return the number of references, written to the dump if `write` is set
+ */
+uint32_t HeapDump_references(HeapDump *dump, Heap *heap, Object *object,
+                             bool write) {
+    uint32_t count = 0;
+    if (object->rtti->rt.id == __object_array_id) {
+        size_t size =
+            Object_Size(&object->header) - OBJECT_HEADER_SIZE - WORD_SIZE;
+        size_t nbWords = size / WORD_SIZE;
+        for (size_t i = 0; i < nbWords; i++) {
+            Object *reference = HeapDump_reference(heap, object->fields[i]);
+            if (reference != NULL) {
+                if (write) {
+                    HeapDump_writeWord(dump, (uint64_t)reference);
+                }
+                count++;
+            }
+        }
+    } else {
+        int64_t *ptr_map = object->rtti->refMapStruct;
+        for (int i = 0; ptr_map[i] != LAST_FIELD_OFFSET; i++) {
+            Object *reference =
+                HeapDump_reference(heap, object->fields[ptr_map[i]]);
+            if (reference != NULL) {
+                if (write) {
+                    HeapDump_writeWord(dump, (uint64_t)reference);
+                }
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+void HeapDump_visit(HeapDump *dump, Heap *heap, Object *object) {
+    size_t size = Object_Size(&object->header);
+    HeapDump_count(dump, object, size);
+    if (dump->fd >= 0) {
+        HeapDump_writeTag(dump, heap_dump_object);
+        HeapDump_writeWord(dump, (uint64_t)object);
+        HeapDump_writeWord(dump, (uint64_t)object->rtti);
+        HeapDump_writeWord(dump, size);
+        HeapDump_writeInt(dump, HeapDump_references(dump, heap, object, false));
+        HeapDump_references(dump, heap, object, true);
+    }
+}
+
+/**
+ * Visits the live objects of the small heap, through the marked lines of the
+ * marked blocks, like `StackOverflowHandler_overflowBlockScan`.
+ */
+void HeapDump_visitSmallHeap(HeapDump *dump, Heap *heap) {
+    for (word_t *current = heap->heapStart; current < heap->heapEnd;
+         current += WORDS_IN_BLOCK) {
+        BlockHeader *block = (BlockHeader *)current;
+        if (!Block_IsMarked(block)) {
+            continue;
+        }
+        for (int lineIndex = 0; lineIndex < (int)LINE_COUNT; lineIndex++) {
+            LineHeader *lineHeader = Block_GetLineHeader(block, lineIndex);
+            if (!Line_IsMarked(lineHeader) ||
+                !Line_ContainsObject(lineHeader)) {
+                continue;
+            }
+            Object *object = Line_GetFirstObject(lineHeader);
+            word_t *lineEnd =
+                Block_GetLineAddress(block, lineIndex) + WORDS_IN_LINE;
+            while (object != NULL && (word_t *)object < lineEnd) {
+                if (Object_IsMarked(object)) {
+                    HeapDump_visit(dump, heap, object);
+                }
+                object = Object_NextObject(object);
+            }
+        }
+    }
+}
+
+void HeapDump_visitLargeHeap(HeapDump *dump, Heap *heap) {
+    ubyte_t *current = (ubyte_t *)largeAllocator.offset;
+    ubyte_t *heapEnd = current + largeAllocator.size;
+    while (current != heapEnd) {
+        ubyte_t *live = Bitmap_FindNextSetBit(largeAllocator.marks, current);
+        if (live == heapEnd) {
+            break;
+        }
+        HeapDump_visit(dump, heap, (Object *)live);
+        current = (ubyte_t *)Object_NextLargeObject((Object *)live);
+    }
+}
+
+void HeapDump_writeClasses(HeapDump *dump) {
+    char name[CLASS_NAME_MAX_LENGTH];
+    for (size_t i = 0; i < dump->capacity; i++) {
+        HeapDumpClass *entry = &dump->classes[i];
+        if (entry->rtti == NULL) {
+            continue;
+        }
+        uint32_t length =
+            (uint32_t)Object_ClassName(entry->rtti, name, sizeof(name));
+        HeapDump_writeTag(dump, heap_dump_class);
+        HeapDump_writeWord(dump, (uint64_t)entry->rtti);
+        HeapDump_writeInt(dump, (uint32_t)entry->rtti->rt.id);
+        HeapDump_writeWord(dump, entry->count);
+        HeapDump_writeWord(dump, entry->bytes);
+        HeapDump_writeInt(dump, length);
+        HeapDump_write(dump, name, length);
+    }
+}
+
+/**
+ * Counts the marked objects of the heap per class, and writes them to the
+ * dump if it has a file. Called with the world stopped, once marking is done.
+ */
+void HeapDump_Take(HeapDump *dump, Heap *heap) {
+    bool writing = dump->fd >= 0;
+    if (writing) {
+        heapDumpBuffered = 0;
+        HeapDump_write(dump, "SNHDUMP", 8);
+        HeapDump_writeInt(dump, HEAP_DUMP_VERSION);
+        HeapDump_writeRoots(dump, heap);
+    }
+    HeapDump_visitSmallHeap(dump, heap);
+    HeapDump_visitLargeHeap(dump, heap);
+    if (writing) {
+        HeapDump_writeClasses(dump);
+        HeapDump_writeTag(dump, heap_dump_end);
+        HeapDump_flush(dump);
+    }
+}
+
+int HeapDump_compareBytes(const void *a, const void *b) {
+    uint64_t left = ((HeapDumpClass *)a)->bytes;
+    uint64_t right = ((HeapDumpClass *)b)->bytes;
+    return left < right ? 1 : left > right ? -1 : 0;
+}
+
+/**
+ * Writes the classes by decreasing number of bytes, in the format of the
+ * class histograms of `jmap -histo`. The table is sorted in place, no object
+ * can be counted afterwards.
+ */
+void HeapDump_WriteHistogram(HeapDump *dump, FILE *file) {
+    qsort(dump->classes, dump->capacity, sizeof(HeapDumpClass),
+          HeapDump_compareBytes);
+    char name[CLASS_NAME_MAX_LENGTH];
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    fprintf(file, " num     #instances         #bytes  class name\n");
+    fprintf(file, "----------------------------------------------\n");
+    for (size_t i = 0; i < dump->count; i++) {
+        HeapDumpClass *entry = &dump->classes[i];
+        Object_ClassName(entry->rtti, name, sizeof(name));
+        fprintf(file, "%4zu: %13llu %14llu  %s\n", i + 1,
+                (unsigned long long)entry->count,
+                (unsigned long long)entry->bytes, name);
+        count += entry->count;
+        bytes += entry->bytes;
+    }
+    fprintf(file, "Total %13llu %14llu\n", (unsigned long long)count,
+            (unsigned long long)bytes);
+}
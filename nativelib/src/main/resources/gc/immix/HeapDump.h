@@ -0,0 +1,69 @@
+#ifndef IMMIX_HEAPDUMP_H
+#define IMMIX_HEAPDUMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "GCTypes.h"
+#include "Heap.h"
+#include "headers/ObjectHeader.h"
+
+/**
+ * Live objects and bytes of one class.
+ */
+typedef struct {
+    Rtti *rtti;
+    uint64_t count;
+    uint64_t bytes;
+} HeapDumpClass;
+
+/**
+ * Snapshot of the live objects, taken between the mark and the sweep of a
+ * collection with the world stopped. The objects are counted per class in an
+ * open addressing hash table, mapped with `mmap` as one of the stopped
+ * threads might hold the lock of `malloc`.
+ *
+ * Given a file, the objects and their references are written to it as well,
+ * in the byte order of the machine. The dump starts with the 8 bytes
+ * `SNHDUMP\0` and the 32-bit version, followed by records that start with a
+ * one byte tag:
+ *
+ * - root (1): the 64-bit address of an object referenced from a stack or a
+ *   module, stacks are scanned conservatively
+ * - object (2): the 64-bit address, rtti and size in bytes of the object,
+ *   the 32-bit number of references and the 64-bit address of each
+ *   referenced object, duplicates included
+ * - class (3): the 64-bit rtti, the 32-bit id, the 64-bit number of objects
+ *   and bytes, the 32-bit length of the name and the name in ASCII
+ * - end (0)
+ *
+ * All the roots come first, then the objects and the classes. Addresses are
+ * those of the object headers.
+ */
+typedef struct {
+    HeapDumpClass *classes;
+    size_t capacity;
+    size_t count;
+    // File descriptor of the dump, or -1 to only count the objects
+    int fd;
+    // Set once the table cannot grow or the file cannot be written
+    bool failed;
+} HeapDump;
+
+typedef enum {
+    heap_dump_end = 0x0,
+    heap_dump_root = 0x1,
+    heap_dump_object = 0x2,
+    heap_dump_class = 0x3,
+} HeapDumpTag;
+
+#define HEAP_DUMP_VERSION 1
+
+bool HeapDump_Init(HeapDump *dump, int fd);
+void HeapDump_Take(HeapDump *dump, Heap *heap);
+void HeapDump_WriteHistogram(HeapDump *dump, FILE *file);
+void HeapDump_Free(HeapDump *dump);
+
+void Heap_CollectAndDump(Heap *heap, Stack *stacks, HeapDump *dump);
+
+#endif // IMMIX_HEAPDUMP_H
@@ -8,42 +8,526 @@
 #include "Log.h"
 #include "Object.h"
 #include "State.h"
+#include "WorkerPool.h"
+#include "WriteBarrier.h"
 #include "utils/MathUtils.h"
 #include "Constants.h"
+#include "HeapDump.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+// Kind of write barrier the code was compiled with, see `WriteBarrierKind`
+extern int __write_barrier;
+extern word_t **__stack_bottom;
 
 void scalanative_collect();
+void scalanative_native_shutdown_init(void (*hook)(void));
+
+// File the GC trace is written to at exit, if any
+static const char *traceFile = NULL;
+// File the allocation profile is written to at exit, if any, and its format
+static const char *profileFile = NULL;
+static ProfilerFormat profileFormat = profiler_format_pprof;
+
+/**
+ * Number of GC threads, either set with the `SCALANATIVE_GC_THREADS`
+ * environment variable or the number of online processors.
+ */
+int scalanative_gcThreadCount() {
+    char *value = getenv("SCALANATIVE_GC_THREADS");
+    long count;
+    if (value != NULL) {
+        count = strtol(value, NULL, 10);
+    } else {
+        count = sysconf(_SC_NPROCESSORS_ONLN);
+        if (count > DEFAULT_MAX_GC_THREADS) {
+            count = DEFAULT_MAX_GC_THREADS;
+        }
+    }
+    if (count < 1) {
+        count = 1;
+    } else if (count > MAX_GC_THREADS) {
+        count = MAX_GC_THREADS;
+    }
+    return (int)count;
+}
+
+/**
+ * Whether the environment variable `name` is set to a value other than `0`.
+ */
+bool scalanative_gcFlag(const char *name) {
+    char *value = getenv(name);
+    return value != NULL && strcmp(value, "0") != 0;
+}
+
+/**
+ * Size in bytes set with the environment variable `name`, with an optional
+ * `k`, `m` or `g` suffix, or `defaultSize` if it is not set or not valid.
+ */
+size_t scalanative_gcSize(const char *name, size_t defaultSize) {
+    char *value = getenv(name);
+    if (value == NULL) {
+        return defaultSize;
+    }
+    char *end;
+    unsigned long long size = strtoull(value, &end, 10);
+    if (end == value) {
+        return defaultSize;
+    }
+    switch (*end) {
+    case 'k':
+    case 'K':
+        size <<= 10;
+        end++;
+        break;
+    case 'm':
+    case 'M':
+        size <<= 20;
+        end++;
+        break;
+    case 'g':
+    case 'G':
+        size <<= 30;
+        end++;
+        break;
+    }
+    if (*end != '\0' || size == 0) {
+        return defaultSize;
+    }
+    return (size_t)size;
+}
+
+/**
+ * Number set with the environment variable `name`, or `defaultValue` if it is
+ * not set or not strictly between `min` and `max`.
+ */
+double scalanative_gcRatio(const char *name, double defaultValue, double min,
+                           double max) {
+    char *value = getenv(name);
+    if (value == NULL) {
+        return defaultValue;
+    }
+    char *end;
+    double ratio = strtod(value, &end);
+    if (end == value || *end != '\0' || ratio <= min || ratio >= max) {
+        return defaultValue;
+    }
+    return ratio;
+}
+
+/**
+ * Pages that back the heap, set with `SCALANATIVE_GC_HUGE_PAGES`: `hugetlb`
+ * for the pool of huge pages, or any other value but `0` for transparent huge
+ * pages.
+ */
+HugePages scalanative_gcHugePages() {
+    char *value = getenv("SCALANATIVE_GC_HUGE_PAGES");
+    if (value == NULL || strcmp(value, "0") == 0) {
+        return huge_pages_none;
+    } else if (strcmp(value, "hugetlb") == 0) {
+        return huge_pages_hugetlb;
+    }
+    return huge_pages_transparent;
+}
+
+/**
+ * Initializes the heap with the sizes and growth rates of the environment.
+ * `SCALANATIVE_GC_MIN_HEAP_SIZE` is split between the small and the large
+ * heap according to `SCALANATIVE_GC_LARGE_HEAP_RATIO`. The heap does not grow
+ * beyond `SCALANATIVE_GC_MAX_HEAP_SIZE`, which defaults to the physical memory
+ * or the memory limit of the cgroup of the process.
+ */
+void scalanative_initHeap() {
+    size_t maxHeapSize = scalanative_gcSize("SCALANATIVE_GC_MAX_HEAP_SIZE",
+                                            Heap_GetMemoryLimit());
+    size_t minHeapSize =
+        scalanative_gcSize("SCALANATIVE_GC_MIN_HEAP_SIZE",
+                           INITIAL_SMALL_HEAP_SIZE + INITIAL_LARGE_HEAP_SIZE);
+    if (minHeapSize > maxHeapSize) {
+        minHeapSize = maxHeapSize;
+    }
+    double largeHeapRatio = scalanative_gcRatio(
+        "SCALANATIVE_GC_LARGE_HEAP_RATIO", DEFAULT_LARGE_HEAP_RATIO, 0, 1);
+
+    // Both heaps start with at least 2 blocks
+    size_t blockSize = (size_t)BLOCK_TOTAL_SIZE;
+    size_t largeHeapSize =
+        (size_t)((double)minHeapSize * largeHeapRatio) / blockSize * blockSize;
+    if (largeHeapSize < 2 * blockSize) {
+        largeHeapSize = 2 * blockSize;
+    }
+    size_t smallHeapSize = minHeapSize > largeHeapSize
+                               ? minHeapSize - largeHeapSize
+                               : 0;
+    smallHeapSize = smallHeapSize / blockSize * blockSize;
+    if (smallHeapSize < 2 * blockSize) {
+        smallHeapSize = 2 * blockSize;
+    }
+    if (maxHeapSize < smallHeapSize + largeHeapSize) {
+        maxHeapSize = smallHeapSize + largeHeapSize;
+    }
+
+    Heap_Init(&heap, smallHeapSize, largeHeapSize, maxHeapSize,
+              scalanative_gcHugePages());
+    heap.earlyGrowthRate = scalanative_gcRatio(
+        "SCALANATIVE_GC_EARLY_GROWTH_RATE", EARLY_GROWTH_RATE, 1, 16);
+    heap.growthRate = scalanative_gcRatio("SCALANATIVE_GC_GROWTH_RATE",
+                                          GROWTH_RATE, 1, 16);
+}
+
+/**
+ * Picks the sizing policy of the heap with `SCALANATIVE_GC_HEAP_POLICY`. The
+ * `adaptive` policy aims at `SCALANATIVE_GC_TIME_RATIO` of the time spent in
+ * pauses, and at pauses shorter than `SCALANATIVE_GC_PAUSE_TARGET`
+ * milliseconds if set. The default policy grows the heap when it is full.
+ */
+void scalanative_initSizingPolicy() {
+    char *name = getenv("SCALANATIVE_GC_HEAP_POLICY");
+    if (name == NULL || strcmp(name, "adaptive") != 0) {
+        SizingPolicy_Init(&sizingPolicy, SizingPolicy_Occupancy);
+        return;
+    }
+    SizingPolicy_Init(&sizingPolicy, SizingPolicy_Adaptive);
+    sizingPolicy.gcTimeRatio = scalanative_gcRatio(
+        "SCALANATIVE_GC_TIME_RATIO", DEFAULT_GC_TIME_RATIO, 0, 1);
+    double pauseTarget =
+        scalanative_gcRatio("SCALANATIVE_GC_PAUSE_TARGET", 0, 0, 1e6);
+    sizingPolicy.pauseTargetNanos = (uint64_t)(pauseTarget * 1000000);
+}
+
+/**
+ * Writes the GC trace to the file at `path`, in the Chrome trace event format.
+ *
+ * @return `0`, or `-1` if the file cannot be written
+ */
+int scalanative_gc_trace_dump(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    Trace_Dump(&trace, file);
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+void scalanative_dumpTraceAtExit() {
+    if (scalanative_gc_trace_dump(traceFile) != 0) {
+        fprintf(stderr, "Failed to write the GC trace to %s\n", traceFile);
+    }
+}
+
+/**
+ * Writes the allocation profile to the file at `path`, either in the legacy
+ * heap profile format of pprof or as folded stacks, see `ProfilerFormat`.
+ *
+ * @return `0`, or `-1` if the profiler is disabled or the file cannot be
+ * written
+ */
+int scalanative_gc_profile_dump(const char *path, int format) {
+    if (!profiler.enabled) {
+        return -1;
+    }
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    Profiler_Write(&profiler, file, (ProfilerFormat)format);
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+void scalanative_dumpProfileAtExit() {
+    if (scalanative_gc_profile_dump(profileFile, profileFormat) != 0) {
+        fprintf(stderr, "Failed to write the allocation profile to %s\n",
+                profileFile);
+    }
+}
+
+/**
+ * Enables the allocation profiler if `SCALANATIVE_GC_PROFILE` names the file
+ * to write the profile to. `SCALANATIVE_GC_PROFILE_INTERVAL` sets the mean
+ * number of bytes between two samples, `SCALANATIVE_GC_PROFILE_FORMAT` is
+ * either `pprof` or `folded`.
+ */
+void scalanative_initProfiler() {
+    profileFile = getenv("SCALANATIVE_GC_PROFILE");
+    if (profileFile == NULL) {
+        return;
+    }
+    char *format = getenv("SCALANATIVE_GC_PROFILE_FORMAT");
+    if (format != NULL && strcmp(format, "folded") == 0) {
+        profileFormat = profiler_format_folded;
+    }
+    size_t interval = scalanative_gcSize("SCALANATIVE_GC_PROFILE_INTERVAL",
+                                         DEFAULT_PROFILER_INTERVAL);
+    if (interval < WORD_SIZE) {
+        interval = DEFAULT_PROFILER_INTERVAL;
+    }
+    Profiler_Init(&profiler, interval);
+    scalanative_native_shutdown_init(scalanative_dumpProfileAtExit);
+}
 
 NOINLINE void scalanative_init() {
-    Heap_Init(&heap, INITIAL_SMALL_HEAP_SIZE, INITIAL_LARGE_HEAP_SIZE);
-    Stack_Init(&stack, INITIAL_STACK_SIZE);
+    traceFile = getenv("SCALANATIVE_GC_TRACE");
+    if (traceFile != NULL) {
+        scalanative_native_shutdown_init(scalanative_dumpTraceAtExit);
+    }
+    // Before the first thread takes its allocation buffer
+    scalanative_initProfiler();
+    scalanative_initHeap();
+    scalanative_initSizingPolicy();
+    MutatorThreads_Init(&mutatorThreads);
+    MutatorThreads_Register(&mutatorThreads, __stack_bottom);
+    WorkerPool_Init(&workerPool, scalanative_gcThreadCount());
+    stacks = malloc(workerPool.count * sizeof(Stack));
+    for (int i = 0; i < workerPool.count; i++) {
+        Stack_Init(&stacks[i], INITIAL_STACK_SIZE);
+    }
+    concurrentMarker.enabled = false;
+    if (__write_barrier == write_barrier_snapshot) {
+        // Concurrent cycles start from the free and recyclable block counts
+        // of an eager sweep
+        ConcurrentMarker_Init(&concurrentMarker,
+                              scalanative_gcFlag("SCALANATIVE_GC_INCREMENTAL"));
+    } else if (__write_barrier == write_barrier_card) {
+        // Lazy sweeping stays off, it expects the sweep to clear every mark
+        heap.generational = true;
+        __write_barrier_active = true;
+    } else {
+        allocator.lazySweep = scalanative_gcFlag("SCALANATIVE_GC_LAZY_SWEEP");
+    }
+    // Objects are only moved by marks that stop the program and are followed
+    // by an eager sweep
+    evacuation.enabled = false;
+    if (!concurrentMarker.enabled && !allocator.lazySweep &&
+        scalanative_gcFlag("SCALANATIVE_GC_DEFRAG")) {
+        Evacuation_Init(&evacuation, heap.heapStart);
+    }
 }
 
 INLINE void *scalanative_alloc(void *info, size_t size) {
     size = MathUtils_RoundToNextMultiple(size, WORD_SIZE);
 
-    void **alloc = (void **)Heap_Alloc(&heap, size);
-    *alloc = info;
-    return (void *)alloc;
+    return (void *)Heap_Alloc(&heap, (Rtti *)info, size);
 }
 
 INLINE void *scalanative_alloc_small(void *info, size_t size) {
     size = MathUtils_RoundToNextMultiple(size, WORD_SIZE);
 
-    void **alloc = (void **)Heap_AllocSmall(&heap, size);
-    *alloc = info;
-    return (void *)alloc;
+    return (void *)Heap_AllocSmall(&heap, (Rtti *)info, size);
+}
+
+/**
+ * Allocation buffer of the calling thread, for the allocation fast path the
+ * compiler inlines. Its first fields are laid out as:
+ *
+ *   { i8 critical, i8 stopRequested, i8* cursor, i8* limit }
+ */
+void *scalanative_alloc_buffer() { return currentMutatorThread; }
+
+/**
+ * Called by the inlined fast path when the buffer is exhausted, in the
+ * critical region it entered.
+ */
+NOINLINE void *scalanative_alloc_small_slow(void *info, size_t size) {
+    size = MathUtils_RoundToNextMultiple(size, WORD_SIZE);
+
+    return (void *)Heap_AllocSmallSlow(&heap, (Rtti *)info, size);
+}
+
+/**
+ * Called by the inlined fast path when a collection asked the thread to stop
+ * while it allocated.
+ */
+NOINLINE void scalanative_alloc_stop() {
+    MutatorThread_Stop(currentMutatorThread);
 }
 
 INLINE void *scalanative_alloc_large(void *info, size_t size) {
     size = MathUtils_RoundToNextMultiple(size, WORD_SIZE);
 
-    void **alloc = (void **)Heap_AllocLarge(&heap, size);
-    *alloc = info;
-    return (void *)alloc;
+    return (void *)Heap_AllocLarge(&heap, (Rtti *)info, size);
 }
 
 INLINE void *scalanative_alloc_atomic(void *info, size_t size) {
     return scalanative_alloc(info, size);
 }
 
-INLINE void scalanative_collect() { Heap_Collect(&heap, &stack); }
+void scalanative_collect() {
+    MutatorThreads_Lock(&mutatorThreads);
+    MutatorThreads_StopTheWorld(&mutatorThreads);
+    Heap_CollectFull(&heap, stacks);
+    MutatorThreads_ResumeTheWorld(&mutatorThreads);
+    MutatorThreads_Unlock(&mutatorThreads);
+}
+
+/**
+ * Collects the heap and takes `dump` of the live objects in the middle.
+ */
+void scalanative_takeHeapDump(HeapDump *dump) {
+    MutatorThreads_Lock(&mutatorThreads);
+    MutatorThreads_StopTheWorld(&mutatorThreads);
+    Heap_CollectAndDump(&heap, stacks, dump);
+    MutatorThreads_ResumeTheWorld(&mutatorThreads);
+    MutatorThreads_Unlock(&mutatorThreads);
+}
+
+/**
+ * Collects the heap and writes the number of live objects and bytes of each
+ * class to the file at `path`, largest classes first.
+ *
+ * @return `0`, or `-1` if the file cannot be written
+ */
+int scalanative_gc_heap_histogram(const char *path) {
+    HeapDump dump;
+    if (!HeapDump_Init(&dump, -1)) {
+        return -1;
+    }
+    scalanative_takeHeapDump(&dump);
+    FILE *file = dump.failed ? NULL : fopen(path, "w");
+    if (file == NULL) {
+        HeapDump_Free(&dump);
+        return -1;
+    }
+    HeapDump_WriteHistogram(&dump, file);
+    HeapDump_Free(&dump);
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+/**
+ * Collects the heap and writes its live objects, their references and the
+ * roots to the file at `path`, in the binary format described in `HeapDump`.
+ *
+ * @return `0`, or `-1` if the file cannot be written
+ */
+int scalanative_gc_heap_dump(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    HeapDump dump;
+    if (!HeapDump_Init(&dump, fd)) {
+        close(fd);
+        return -1;
+    }
+    scalanative_takeHeapDump(&dump);
+    bool failed = dump.failed;
+    HeapDump_Free(&dump);
+    return close(fd) == 0 && !failed ? 0 : -1;
+}
+
+/**
+ * Registers the calling thread with the collector, its stack starts at
+ * `stackBottom`. Must be called before the thread uses the heap.
+ */
+void scalanative_register_thread(void *stackBottom) {
+    MutatorThreads_Register(&mutatorThreads, (word_t **)stackBottom);
+}
+
+/**
+ * Unregisters the calling thread, before it exits.
+ */
+void scalanative_unregister_thread() {
+    MutatorThreads_Unregister(&mutatorThreads, currentMutatorThread);
+}
+
+/**
+ * Makes sure that the calling thread has a buffer to log slots to. Allocating
+ * one leaves the critical region, as `malloc` might wait for a stopped thread,
+ * thus the thread might stop for a collection meanwhile.
+ *
+ * @return whether the thread left the critical region
+ */
+static bool scalanative_takeLogBuffer(MutatorThread *thread) {
+    if (thread->logBuffer != NULL) {
+        return false;
+    }
+    LogBuffer *buffer = WriteBarrier_TakeFreeBuffer();
+    bool left = buffer == NULL;
+    if (left) {
+        MutatorThread_LeaveCritical(thread);
+        buffer = WriteBarrier_NewBuffer();
+        MutatorThread_EnterCritical(thread);
+    }
+    // Only the collector touches the buffer in the meantime, to flush it
+    thread->logBuffer = buffer;
+    return left;
+}
+
+/**
+ * Called before a reference is stored to `slot`, while a concurrent mark is in
+ * progress or at any time with sticky marks. The compiler emits the check of
+ * `__write_barrier_active`, the call and the store in a critical region of the
+ * thread, so that no collection starts or ends between them.
+ */
+void scalanative_write_barrier(void **slot) {
+    if (heap.generational) {
+        WriteBarrier_MarkCard(&heap, (word_t **)slot);
+        return;
+    }
+    MutatorThread *thread = currentMutatorThread;
+    scalanative_takeLogBuffer(thread);
+    // The cycle might have ended while the thread was stopped, the slot still
+    // holds its old value
+    if (__write_barrier_active) {
+        WriteBarrier_LogSlot(&heap, &thread->logBuffer, (word_t **)slot);
+    }
+}
+
+/**
+ * Copies `size` bytes of references from `from` to `to`. The references
+ * overwritten go through the write barrier first, in the same critical region
+ * as the copy.
+ */
+void scalanative_copy_references(void *to, void *from, size_t size) {
+    MutatorThread *thread = currentMutatorThread;
+    word_t **start = (word_t **)to;
+    word_t **end = (word_t **)((ubyte_t *)to + size);
+    MutatorThread_EnterCritical(thread);
+    uint64_t collections = stats.collections;
+    word_t **slot = start;
+    while (__write_barrier_active && slot < end) {
+        if (heap.generational) {
+            WriteBarrier_MarkCard(&heap, slot++);
+        } else if (!scalanative_takeLogBuffer(thread)) {
+            WriteBarrier_LogSlot(&heap, &thread->logBuffer, slot++);
+        } else if (stats.collections != collections) {
+            // The slots logged so far belong to a cycle that ended while the
+            // thread was stopped
+            collections = stats.collections;
+            slot = start;
+        }
+    }
+    memmove(to, from, size);
+    MutatorThread_LeaveCritical(thread);
+}
+
+/**
+ * Copies the statistics of the collector to `result`, with the current size
+ * of the heap and the bytes the running threads allocated so far.
+ */
+void scalanative_gc_stats(GCStats *result) {
+    MutatorThreads_Lock(&mutatorThreads);
+    *result = stats;
+    result->heapBytes = heap.smallHeapSize + heap.largeHeapSize;
+    for (MutatorThread *thread = mutatorThreads.first; thread != NULL;
+         thread = thread->next) {
+        result->allocatedBytes +=
+            __atomic_load_n(&thread->tlab.allocatedBytes, __ATOMIC_RELAXED);
+    }
+    MutatorThreads_Unlock(&mutatorThreads);
+}
+
+/**
+ * Whether objects are moved, hashed objects are only pinned if they are.
+ */
+bool scalanative_gc_moves_objects() { return evacuation.enabled; }
+
+/**
+ * Keeps the object at `address` in place, its address is used as its identity
+ * hash code.
+ */
+void scalanative_pin(void *address) {
+    Object *object = Object_FromMutatorAddress((word_t *)address);
+    if (Heap_IsWordInSmallHeap(&heap, (word_t *)object)) {
+        Object_Pin(&object->header);
+    }
+}
@@ -1,17 +1,14 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include "LargeAllocator.h"
 #include "utils/MathUtils.h"
+#include "utils/MemoryUtils.h"
 #include "Object.h"
 #include "Log.h"
 #include "headers/ObjectHeader.h"
 
-inline static int LargeAllocator_sizeToLinkedListIndex(size_t size) {
-    assert(size >= MIN_BLOCK_SIZE);
-    return log2_floor(size) - LARGE_OBJECT_MIN_SIZE_BITS;
-}
-
 static inline size_t LargeAllocator_getChunkSize(Chunk *chunk) {
     return (chunk->header.size << WORD_SIZE_BITS);
 }
@@ -24,162 +21,254 @@ Chunk *LargeAllocator_chunkAddOffset(Chunk *chunk, size_t words) {
     return (Chunk *)((ubyte_t *)chunk + words);
 }
 
-void LargeAllocator_printFreeList(FreeList *list, int i) {
-    Chunk *current = list->first;
-    printf("list %d: ", i);
-    while (current != NULL) {
-        assert((1 << (i + LARGE_OBJECT_MIN_SIZE_BITS)) ==
-               LargeAllocator_getChunkSize(current));
-        printf("[%p %zu] -> ", current, LargeAllocator_getChunkSize(current));
-        current = current->next;
+/**
+ * Finds the list of the chunks of `size`.
+ */
+static inline void LargeAllocator_mapping(size_t size, int *first,
+                                          int *second) {
+    assert(size >= MIN_BLOCK_SIZE);
+    int lastBit = MathUtils_LastSetBit(size);
+    *first = lastBit - LARGE_OBJECT_MIN_SIZE_BITS;
+    *second =
+        (int)(size >> (lastBit - SECOND_LEVEL_BITS)) - SECOND_LEVEL_COUNT;
+}
+
+void LargeAllocator_freeListInsert(LargeAllocator *allocator, Chunk *chunk) {
+    int first, second;
+    LargeAllocator_mapping(LargeAllocator_getChunkSize(chunk), &first,
+                           &second);
+    Chunk *head = allocator->freeLists[first][second];
+    chunk->previous = NULL;
+    chunk->next = head;
+    if (head != NULL) {
+        head->previous = chunk;
     }
-    printf("\n");
+    allocator->freeLists[first][second] = chunk;
+    allocator->secondLevelBitmaps[first] |= 1U << second;
+    allocator->firstLevelBitmap |= 1U << first;
 }
 
-void LargeAllocator_freeListAddBlockLast(FreeList *freeList, Chunk *chunk) {
-    if (freeList->first == NULL) {
-        freeList->first = chunk;
+void LargeAllocator_freeListRemove(LargeAllocator *allocator, Chunk *chunk) {
+    int first, second;
+    LargeAllocator_mapping(LargeAllocator_getChunkSize(chunk), &first,
+                           &second);
+    if (chunk->previous != NULL) {
+        chunk->previous->next = chunk->next;
+    } else {
+        allocator->freeLists[first][second] = chunk->next;
+    }
+    if (chunk->next != NULL) {
+        chunk->next->previous = chunk->previous;
+    }
+    if (allocator->freeLists[first][second] == NULL) {
+        allocator->secondLevelBitmaps[first] &= ~(1U << second);
+        if (allocator->secondLevelBitmaps[first] == 0) {
+            allocator->firstLevelBitmap &= ~(1U << first);
+        }
     }
-    freeList->last = chunk;
-    chunk->next = NULL;
 }
 
-Chunk *LargeAllocator_freeListRemoveFirstBlock(FreeList *freeList) {
-    if (freeList->first == NULL) {
-        return NULL;
+/**
+ * Finds a free chunk of at least `size` bytes in constant time. The size is
+ * rounded up to the next list, so that any chunk of that list fits.
+ */
+Chunk *LargeAllocator_findChunk(LargeAllocator *allocator, size_t size) {
+    size_t rounded =
+        size + (1UL << (MathUtils_LastSetBit(size) - SECOND_LEVEL_BITS)) - 1;
+    // Chunks are at most `MAX_BLOCK_SIZE`, all the chunks of its list fit
+    if (rounded > MAX_BLOCK_SIZE) {
+        rounded = MAX_BLOCK_SIZE;
     }
-    Chunk *chunk = freeList->first;
-    if (freeList->first == freeList->last) {
-        freeList->last = NULL;
+    int first, second;
+    LargeAllocator_mapping(rounded, &first, &second);
+
+    uint32_t secondLevel =
+        allocator->secondLevelBitmaps[first] & (~0U << second);
+    if (secondLevel == 0) {
+        uint32_t firstLevel =
+            allocator->firstLevelBitmap & (~0U << (first + 1));
+        if (firstLevel == 0) {
+            return NULL;
+        }
+        first = __builtin_ctz(firstLevel);
+        secondLevel = allocator->secondLevelBitmaps[first];
     }
+    second = __builtin_ctz(secondLevel);
+    return allocator->freeLists[first][second];
+}
 
-    freeList->first = chunk->next;
-    return chunk;
+void LargeAllocator_printFreeList(Chunk *current, int first, int second) {
+    printf("list %d.%d: ", first, second);
+    while (current != NULL) {
+        printf("[%p %zu] -> ", current, LargeAllocator_getChunkSize(current));
+        current = current->next;
+    }
+    printf("\n");
 }
 
-void LargeAllocator_freeListInit(FreeList *freeList) {
-    freeList->first = NULL;
-    freeList->last = NULL;
+void LargeAllocator_clearFreeLists(LargeAllocator *allocator) {
+    allocator->firstLevelBitmap = 0;
+    for (int i = 0; i < FIRST_LEVEL_COUNT; i++) {
+        allocator->secondLevelBitmaps[i] = 0;
+        for (int j = 0; j < SECOND_LEVEL_COUNT; j++) {
+            allocator->freeLists[i][j] = NULL;
+        }
+    }
 }
 
 void LargeAllocator_Init(LargeAllocator *allocator, word_t *offset,
-                         size_t size) {
+                         size_t size, bool decommit) {
     allocator->offset = offset;
     allocator->size = size;
+    allocator->liveSize = 0;
+    allocator->decommit = decommit;
     allocator->bitmap = Bitmap_Alloc(size, offset);
+    allocator->marks = Bitmap_Alloc(size, offset);
+    allocator->cards = Bitmap_Alloc(size, offset);
 
-    for (int i = 0; i < FREE_LIST_COUNT; i++) {
-        LargeAllocator_freeListInit(&allocator->freeLists[i]);
-    }
+    LargeAllocator_clearFreeLists(allocator);
 
     LargeAllocator_AddChunk(allocator, (Chunk *)offset, size);
 }
 
-void LargeAllocator_AddChunk(LargeAllocator *allocator, Chunk *chunk,
-                             size_t total_block_size) {
-    assert(total_block_size >= MIN_BLOCK_SIZE);
-    assert(total_block_size % MIN_BLOCK_SIZE == 0);
-
-    size_t remaining_size = total_block_size;
+/**
+ * Adds the free space as is, only chunks larger than `MAX_BLOCK_SIZE` are
+ * split.
+ */
+void LargeAllocator_addFreeSpace(LargeAllocator *allocator, Chunk *chunk,
+                                 size_t size) {
     ubyte_t *current = (ubyte_t *)chunk;
-    while (remaining_size > 0) {
-        int log2_f = log2_floor(remaining_size);
-        size_t chunkSize = 1UL << log2_f;
-        chunkSize = chunkSize > MAX_BLOCK_SIZE ? MAX_BLOCK_SIZE : chunkSize;
-        assert(chunkSize >= MIN_BLOCK_SIZE && chunkSize <= MAX_BLOCK_SIZE);
-        int listIndex = LargeAllocator_sizeToLinkedListIndex(chunkSize);
-
+    while (size > 0) {
+        size_t chunkSize = size > MAX_BLOCK_SIZE ? MAX_BLOCK_SIZE : size;
         Chunk *currentChunk = (Chunk *)current;
-        LargeAllocator_freeListAddBlockLast(&allocator->freeLists[listIndex],
-                                            (Chunk *)current);
         LargeAllocator_setChunkSize(currentChunk, chunkSize);
         currentChunk->header.type = object_large;
-        Object_SetFree(&((Object *)currentChunk)->header);
+        Object_SetFree(&currentChunk->header);
         Bitmap_SetBit(allocator->bitmap, current);
+        LargeAllocator_freeListInsert(allocator, currentChunk);
 
         current += chunkSize;
-        remaining_size -= chunkSize;
+        size -= chunkSize;
     }
 }
 
+/**
+ * Adds free space to the allocator. The chunks freed by the sweep are already
+ * merged with their free neighbours, this merges the space the heap grows by
+ * with the free chunk that ends the heap, if any.
+ */
+void LargeAllocator_AddChunk(LargeAllocator *allocator, Chunk *chunk,
+                             size_t total_block_size) {
+    assert(total_block_size >= MIN_BLOCK_SIZE);
+    assert(total_block_size % MIN_BLOCK_SIZE == 0);
+
+    if ((word_t *)chunk != allocator->offset) {
+        Chunk *previous = (Chunk *)Bitmap_FindPreviousSetBit(
+            allocator->bitmap, (ubyte_t *)chunk - MIN_BLOCK_SIZE);
+        size_t previousSize = LargeAllocator_getChunkSize(previous);
+        if (Object_IsFree(&previous->header) &&
+            LargeAllocator_chunkAddOffset(previous, previousSize) == chunk) {
+            LargeAllocator_freeListRemove(allocator, previous);
+            Bitmap_ClearBit(allocator->bitmap, (ubyte_t *)chunk);
+            chunk = previous;
+            total_block_size += previousSize;
+        }
+    }
+    LargeAllocator_addFreeSpace(allocator, chunk, total_block_size);
+}
+
 Object *LargeAllocator_GetBlock(LargeAllocator *allocator,
                                 size_t requestedBlockSize) {
     size_t actualBlockSize =
         MathUtils_RoundToNextMultiple(requestedBlockSize, MIN_BLOCK_SIZE);
-    size_t requiredChunkSize = 1UL << MathUtils_Log2Ceil(actualBlockSize);
-
-    int listIndex = LargeAllocator_sizeToLinkedListIndex(requiredChunkSize);
-    Chunk *chunk = NULL;
-    while (listIndex <= FREE_LIST_COUNT - 1 &&
-           (chunk = allocator->freeLists[listIndex].first) == NULL) {
-        ++listIndex;
-    }
 
+    Chunk *chunk = LargeAllocator_findChunk(allocator, actualBlockSize);
     if (chunk == NULL) {
         return NULL;
     }
+    LargeAllocator_freeListRemove(allocator, chunk);
 
     size_t chunkSize = LargeAllocator_getChunkSize(chunk);
-    assert(chunkSize >= MIN_BLOCK_SIZE);
-
-    if (chunkSize - MIN_BLOCK_SIZE >= actualBlockSize) {
-        Chunk *remainingChunk =
-            LargeAllocator_chunkAddOffset(chunk, actualBlockSize);
-        LargeAllocator_freeListRemoveFirstBlock(
-            &allocator->freeLists[listIndex]);
-        size_t remainingChunkSize = chunkSize - actualBlockSize;
-        LargeAllocator_AddChunk(allocator, remainingChunk, remainingChunkSize);
-    } else {
-        LargeAllocator_freeListRemoveFirstBlock(
-            &allocator->freeLists[listIndex]);
-    }
+    assert(chunkSize >= actualBlockSize);
 
-    Bitmap_SetBit(allocator->bitmap, (ubyte_t *)chunk);
     Object *object = (Object *)chunk;
     Object_SetAllocated(&object->header);
+    // Sizes are multiples of `MIN_BLOCK_SIZE`, the rest is a chunk on its own
+    if (chunkSize > actualBlockSize) {
+        LargeAllocator_addFreeSpace(
+            allocator, LargeAllocator_chunkAddOffset(chunk, actualBlockSize),
+            chunkSize - actualBlockSize);
+    }
+
     memset(Object_ToMutatorAddress(object), 0, actualBlockSize - WORD_SIZE);
     return object;
 }
 
 void LargeAllocator_Print(LargeAllocator *alloc) {
-    for (int i = 0; i < FREE_LIST_COUNT; i++) {
-        if (alloc->freeLists[i].first != NULL) {
-
-            LargeAllocator_printFreeList(&alloc->freeLists[i], i);
+    for (int i = 0; i < FIRST_LEVEL_COUNT; i++) {
+        for (int j = 0; j < SECOND_LEVEL_COUNT; j++) {
+            if (alloc->freeLists[i][j] != NULL) {
+                LargeAllocator_printFreeList(alloc->freeLists[i][j], i, j);
+            }
         }
     }
 }
 
-void LargeAllocator_clearFreeLists(LargeAllocator *allocator) {
-    for (int i = 0; i < FREE_LIST_COUNT; i++) {
-        allocator->freeLists[i].first = NULL;
-        allocator->freeLists[i].last = NULL;
-    }
-}
-
-void LargeAllocator_Sweep(LargeAllocator *allocator) {
+/**
+ * Frees the chunks between the marked objects, found with the mark bitmap a
+ * word at a time. Every run of dead chunks is freed at once. The runs stay
+ * committed up to `SHRINK_HEADROOM` free bytes per byte that survived the
+ * previous sweep, so that the next large allocations do not fault them back
+ * in, the pages of the other runs are returned to the OS. With huge pages,
+ * they all stay committed.
+ */
+void LargeAllocator_Sweep(LargeAllocator *allocator, bool stickyMarks) {
     LargeAllocator_clearFreeLists(allocator);
+    size_t retained = SIZE_MAX;
+    if (allocator->decommit) {
+        retained = allocator->liveSize * SHRINK_HEADROOM;
+    }
+    allocator->liveSize = 0;
 
-    Object *current = (Object *)allocator->offset;
-    void *heapEnd = (ubyte_t *)allocator->offset + allocator->size;
+    ubyte_t *current = (ubyte_t *)allocator->offset;
+    ubyte_t *heapEnd = current + allocator->size;
 
     while (current != heapEnd) {
-        assert(Bitmap_GetBit(allocator->bitmap, (ubyte_t *)current));
-        ObjectHeader *currentHeader = &current->header;
-        if (Object_IsMarked(currentHeader)) {
-            Object_SetAllocated(currentHeader);
-
-            current = Object_NextLargeObject(current);
-        } else {
-            size_t currentSize = Object_ChunkSize(current);
-            Object *next = Object_NextLargeObject(current);
-            while (next != heapEnd && !Object_IsMarked(&next->header)) {
-                currentSize += Object_ChunkSize(next);
-                Bitmap_ClearBit(allocator->bitmap, (ubyte_t *)next);
-                next = Object_NextLargeObject(next);
+        ubyte_t *live = Bitmap_FindNextSetBit(allocator->marks, current);
+        if (live != current) {
+            Bitmap_ClearRange(allocator->bitmap, current, live);
+            size_t size = live - current;
+            if (size > retained) {
+                // Done before the chunk headers are written, as the pages read
+                // as zeroes afterwards
+                size_t kept =
+                    retained > sizeof(Chunk) ? retained : sizeof(Chunk);
+                bool decommitted = MemoryUtils_Decommit(current + kept, live);
+                // Stops returning pages if the OS refuses
+                retained = decommitted ? 0 : SIZE_MAX;
+            } else {
+                retained -= size;
             }
-            LargeAllocator_AddChunk(allocator, (Chunk *)current, currentSize);
-            current = next;
+            LargeAllocator_addFreeSpace(allocator, (Chunk *)current,
+                                        live - current);
+        }
+        if (live == heapEnd) {
+            break;
         }
+        assert(Bitmap_GetBit(allocator->bitmap, live));
+        current = (ubyte_t *)Object_NextLargeObject((Object *)live);
+        allocator->liveSize += current - live;
     }
+    if (!stickyMarks) {
+        Bitmap_ClearAll(allocator->marks);
+    }
+}
+
+/**
+ * Unmarks the large objects and clears the dirty cards, so that the next mark
+ * traces the whole large heap again.
+ */
+void LargeAllocator_ClearMarks(LargeAllocator *allocator) {
+    Bitmap_ClearAll(allocator->marks);
+    Bitmap_ClearAll(allocator->cards);
 }
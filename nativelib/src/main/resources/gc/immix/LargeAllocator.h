@@ -6,35 +6,48 @@
 #include "Constants.h"
 #include "headers/ObjectHeader.h"
 
-#define FREE_LIST_COUNT                                                        \
+// Two-level segregated fit: the first level splits the sizes by powers of 2,
+// the second level splits each of them in `SECOND_LEVEL_COUNT` ranges
+#define FIRST_LEVEL_COUNT                                                      \
     (LARGE_OBJECT_MAX_SIZE_BITS - LARGE_OBJECT_MIN_SIZE_BITS + 1)
+#define SECOND_LEVEL_BITS 4
+#define SECOND_LEVEL_COUNT (1 << SECOND_LEVEL_BITS)
 
 typedef struct Chunk Chunk;
 
 struct Chunk {
     ObjectHeader header;
     Chunk *next;
+    Chunk *previous;
 };
 
-typedef struct {
-    Chunk *first;
-    Chunk *last;
-} FreeList;
-
 typedef struct {
     word_t *offset;
     size_t size;
-    FreeList freeLists[FREE_LIST_COUNT];
+    // Bytes of the objects that survived the last sweep
+    size_t liveSize;
+    // Whether the sweep returns free runs to the OS, not with huge pages
+    bool decommit;
+    // The lists that hold chunks, and of the second level ones per first level
+    uint32_t firstLevelBitmap;
+    uint32_t secondLevelBitmaps[FIRST_LEVEL_COUNT];
+    Chunk *freeLists[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+    // The first chunk of every object and free chunk
     Bitmap *bitmap;
+    // The marked objects, set at their first chunk
+    Bitmap *marks;
+    // Chunks dirtied by the card-marking write barrier
+    Bitmap *cards;
 } LargeAllocator;
 
 void LargeAllocator_Init(LargeAllocator *allocator, word_t *offset,
-                         size_t largeHeapSize);
+                         size_t largeHeapSize, bool decommit);
 void LargeAllocator_AddChunk(LargeAllocator *allocator, Chunk *chunk,
                              size_t total_block_size);
 Object *LargeAllocator_GetBlock(LargeAllocator *allocator,
                                 size_t requestedBlockSize);
-void LargeAllocator_Sweep(LargeAllocator *allocator);
+void LargeAllocator_Sweep(LargeAllocator *allocator, bool stickyMarks);
+void LargeAllocator_ClearMarks(LargeAllocator *allocator);
 void LargeAllocator_Print(LargeAllocator *alloc);
 
 #endif // IMMIX_LARGEALLOCATOR_H
@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <string.h>
 #include <setjmp.h>
+#include <sched.h>
 #include "Marker.h"
 #include "Object.h"
 #include "Log.h"
@@ -12,20 +14,110 @@
 extern int __object_array_id;
 extern word_t *__modules;
 extern int __modules_size;
-extern word_t **__stack_bottom;
 
 #define LAST_FIELD_OFFSET -1
+// Number of lines a small heap object can span
+#define MAX_LINES_PER_OBJECT (LARGE_BLOCK_SIZE / LINE_SIZE)
+
+// Number of GC threads that are still looking for objects to trace
+static int activeMarkers;
+// Set while a single GC thread marks with the world stopped, it then marks
+// and pops without atomic operations
+static bool markSerially;
 
 void Marker_Mark(Heap *heap, Stack *stack);
 void StackOverflowHandler_largeHeapOverflowHeapScan(Heap *heap, Stack *stack);
 bool StackOverflowHandler_smallHeapOverflowHeapScan(Heap *heap, Stack *stack);
 
+/**
+ * Pushes an object to scan, or the fields of an object array left to scan
+ * from `start`. If the stack cannot grow, the object is already marked and
+ * the overflow handler finds it.
+ */
+void Marker_push(Stack *stack, Object *object, size_t start) {
+    if (!__atomic_load_n(&overflow, __ATOMIC_RELAXED)) {
+        if (Stack_Push(stack, object, start)) {
+            __atomic_store_n(&overflow, true, __ATOMIC_RELAXED);
+        }
+    }
+}
+
 void Marker_markObject(Heap *heap, Stack *stack, Object *object) {
-    assert(!Object_IsMarked(&object->header));
     assert(Object_Size(&object->header) != 0);
-    Object_Mark(object);
-    if (!overflow) {
-        overflow = Stack_Push(stack, object);
+    // Another GC thread might have marked the object in the meantime
+    if (markSerially ? Object_MarkSerial(object) : Object_Mark(object)) {
+        Marker_push(stack, object, 0);
+    }
+}
+
+/**
+ * Moves an unmarked object out of an evacuation candidate, or marks it in
+ * place if it is pinned or there is no room left. The GC thread that claims
+ * the object first does either, the others wait for it to be done.
+ *
+ * @return the address of the object after marking
+ */
+Object *Marker_evacuate(Stack *stack, Object *object) {
+    ObjectHeader *header = &object->header;
+    uint8_t flag = object_allocated;
+    if (!__atomic_compare_exchange_n(&header->flag, &flag, object_forwarding,
+                                     false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_ACQUIRE)) {
+        while (flag == object_forwarding) {
+            sched_yield();
+            flag = __atomic_load_n(&header->flag, __ATOMIC_ACQUIRE);
+        }
+        return flag == object_forwarded ? (Object *)object->rtti : object;
+    }
+
+    // Marked in place by a conservative reference
+    if (Object_IsMarked(object)) {
+        __atomic_store_n(&header->flag, object_allocated, __ATOMIC_RELEASE);
+        return object;
+    }
+
+    size_t size = Object_Size(header);
+    Object *copy = NULL;
+    if (!Object_IsPinned(header)) {
+        copy = (Object *)Evacuation_Allocate(&evacuation, size);
+    }
+    if (copy == NULL) {
+        bool marked = Object_Mark(object);
+        __atomic_store_n(&header->flag, object_allocated, __ATOMIC_RELEASE);
+        if (marked) {
+            Marker_push(stack, object, 0);
+        }
+        return object;
+    }
+
+    memcpy(copy, object, size);
+    copy->header.flag = object_allocated;
+    Object_Mark(copy);
+    // The forwarding address replaces the rtti of the old copy
+    object->rtti = (Rtti *)copy;
+    __atomic_store_n(&header->flag, object_forwarded, __ATOMIC_RELEASE);
+    Marker_push(stack, copy, 0);
+    return copy;
+}
+
+/**
+ * Marks the object referenced by a precise reference, which is updated if the
+ * object gets moved.
+ */
+static inline void Marker_markField(Heap *heap, Stack *stack, word_t **field) {
+    Object *fieldObject = Object_FromMutatorAddress(*field);
+    if (!heap_isObjectInHeap(heap, fieldObject) ||
+        Object_IsMarked(fieldObject)) {
+        return;
+    }
+    if (Evacuation_IsActive(&evacuation) &&
+        Heap_IsWordInSmallHeap(heap, (word_t *)fieldObject) &&
+        Block_IsEvacuationCandidate(
+            Block_GetBlockHeader((word_t *)fieldObject))) {
+        Object *moved = Marker_evacuate(stack, fieldObject);
+        *field = Object_ToMutatorAddress(moved);
+    } else {
+        Marker_markObject(heap, stack, fieldObject);
     }
 }
 
@@ -49,62 +141,202 @@ void Marker_markConservative(Heap *heap, Stack *stack, word_t *address) {
         object = Object_GetLargeObject(&largeAllocator, address);
     }
 
-    if (object != NULL && !Object_IsMarked(&object->header)) {
+    if (object != NULL && !Object_IsMarked(object)) {
         Marker_markObject(heap, stack, object);
     }
 }
 
+/**
+ * Scans the fields of an object array from `start`. The fields are scanned
+ * `ARRAY_CHUNK_SIZE` at a time: the rest of a large array is pushed back
+ * first, so that the stack grows by a chunk at most and the other GC threads
+ * can steal the rest.
+ */
+void Marker_scanArray(Heap *heap, Stack *stack, Object *object,
+                      size_t start) {
+    // remove header and rtti from size
+    size_t size = Object_Size(&object->header) - OBJECT_HEADER_SIZE - WORD_SIZE;
+    size_t end = size / WORD_SIZE;
+    if (end - start > ARRAY_CHUNK_SIZE) {
+        end = start + ARRAY_CHUNK_SIZE;
+        Marker_push(stack, object, end);
+    }
+    for (size_t i = start; i < end; i++) {
+        Marker_markField(heap, stack, &object->fields[i]);
+    }
+}
+
+void Marker_scanObject(Heap *heap, Stack *stack, Object *object) {
+    if (object->rtti->rt.id == __object_array_id) {
+        Marker_scanArray(heap, stack, object, 0);
+    } else {
+        int64_t *ptr_map = object->rtti->refMapStruct;
+        int i = 0;
+        while (ptr_map[i] != LAST_FIELD_OFFSET) {
+            Marker_markField(heap, stack, &object->fields[ptr_map[i]]);
+            ++i;
+        }
+    }
+}
+
+/**
+ * Marks the unmarked objects referenced from `start` to `end`.
+ */
+void Marker_scanRange(Heap *heap, Stack *stack, word_t **start,
+                      word_t **end) {
+    for (word_t **slot = start; slot < end; slot++) {
+        Marker_markField(heap, stack, slot);
+    }
+}
+
+void Marker_ScanEntry(Heap *heap, Stack *stack, Stack_Type *entry) {
+    if (entry->start != 0) {
+        Marker_scanArray(heap, stack, entry->object, entry->start);
+    } else {
+        Marker_scanObject(heap, stack, entry->object);
+    }
+}
+
+void Marker_drain(Heap *heap, Stack *stack) {
+    Stack_Type entry;
+    if (markSerially) {
+        while (Stack_PopSerial(stack, &entry)) {
+            Marker_ScanEntry(heap, stack, &entry);
+        }
+        return;
+    }
+    while (Stack_Pop(stack, &entry)) {
+        Marker_ScanEntry(heap, stack, &entry);
+    }
+}
+
+/**
+ * Traces all objects reachable from `stack` on the calling thread.
+ */
 void Marker_Mark(Heap *heap, Stack *stack) {
-    while (!Stack_IsEmpty(stack)) {
-        Object *object = Stack_Pop(stack);
-
-        if (object->rtti->rt.id == __object_array_id) {
-            // remove header and rtti from size
-            size_t size =
-                Object_Size(&object->header) - OBJECT_HEADER_SIZE - WORD_SIZE;
-            size_t nbWords = size / WORD_SIZE;
-            for (int i = 0; i < nbWords; i++) {
-
-                word_t *field = object->fields[i];
-                Object *fieldObject = Object_FromMutatorAddress(field);
-                if (heap_isObjectInHeap(heap, fieldObject) &&
-                    !Object_IsMarked(&fieldObject->header)) {
-                    Marker_markObject(heap, stack, fieldObject);
-                }
-            }
-        } else {
-            int64_t *ptr_map = object->rtti->refMapStruct;
-            int i = 0;
-            while (ptr_map[i] != LAST_FIELD_OFFSET) {
-                word_t *field = object->fields[ptr_map[i]];
-                Object *fieldObject = Object_FromMutatorAddress(field);
-                if (heap_isObjectInHeap(heap, fieldObject) &&
-                    !Object_IsMarked(&fieldObject->header)) {
-                    Marker_markObject(heap, stack, fieldObject);
-                }
-                ++i;
-            }
+    Marker_drain(heap, stack);
+    StackOverflowHandler_CheckForOverflow();
+}
+
+/**
+ * Tries to steal an entry from the other GC threads, starting with the
+ * neighbour of `workerId`.
+ */
+bool Marker_steal(int workerId, Stack_Type *entry) {
+    int count = workerPool.count;
+    for (int i = 1; i < count; i++) {
+        if (Stack_Steal(&stacks[(workerId + i) % count], entry)) {
+            return true;
         }
     }
+    return false;
+}
+
+bool Marker_isWorkAvailable() {
+    for (int i = 0; i < workerPool.count; i++) {
+        if (!Stack_IsEmpty(&stacks[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Called by a GC thread that ran out of work. Waits until either another
+ * thread has objects left to steal, or all the threads ran out of work.
+ *
+ * @return `true` if marking is over, `false` if the thread should try to
+ * steal again.
+ */
+bool Marker_terminate() {
+    __atomic_sub_fetch(&activeMarkers, 1, __ATOMIC_ACQ_REL);
+    while (true) {
+        if (__atomic_load_n(&activeMarkers, __ATOMIC_ACQUIRE) == 0) {
+            return true;
+        }
+        if (Marker_isWorkAvailable()) {
+            __atomic_add_fetch(&activeMarkers, 1, __ATOMIC_ACQ_REL);
+            return false;
+        }
+        sched_yield();
+    }
+}
+
+void Marker_markWorker(int workerId, void *arg) {
+    Heap *heap = (Heap *)arg;
+    Stack *stack = &stacks[workerId];
+
+    while (true) {
+        Marker_drain(heap, stack);
+
+        Stack_Type entry;
+        if (Marker_steal(workerId, &entry)) {
+            Marker_ScanEntry(heap, stack, &entry);
+        } else if (Marker_terminate()) {
+            Object_TakeMarkedCounts(&allocator.markedBlockCount,
+                                    &allocator.markedLineCount);
+            return;
+        }
+    }
+}
+
+/**
+ * Traces the heap from the objects in `stacks[0]`, using all the GC threads
+ * of the pool. With a single GC thread, nothing is stolen and the mark skips
+ * the atomic operations.
+ */
+void Marker_MarkParallel(Heap *heap) {
+    if (workerPool.count == 1) {
+        markSerially = true;
+        Marker_Mark(heap, &stacks[0]);
+        markSerially = false;
+        Stack_ReleaseRetired(&stacks[0]);
+        Object_TakeMarkedCounts(&allocator.markedBlockCount,
+                                &allocator.markedLineCount);
+        return;
+    }
+    activeMarkers = workerPool.count;
+    WorkerPool_Run(&workerPool, Marker_markWorker, heap);
+    // No thread reads the old buffers of the stacks anymore
+    for (int i = 0; i < workerPool.count; i++) {
+        Stack_ReleaseRetired(&stacks[i]);
+    }
     StackOverflowHandler_CheckForOverflow();
+    // Objects found by the overflow handler were marked on this thread
+    Object_TakeMarkedCounts(&allocator.markedBlockCount,
+                            &allocator.markedLineCount);
 }
 
+/**
+ * Conservatively marks the objects referenced from `top` to `bottom`.
+ */
+void Marker_markStack(Heap *heap, Stack *stack, word_t **top,
+                      word_t **bottom) {
+    for (word_t **current = top; current <= bottom; current++) {
+        // Looked up as an inner pointer, as a stopped thread may hold the
+        // address of the header of the object it just allocated
+        word_t *stackObject = *current;
+        if (Heap_IsWordInHeap(heap, stackObject)) {
+            Marker_markConservative(heap, stack, stackObject);
+        }
+    }
+}
+
+/**
+ * Marks the objects referenced by the stacks of the mutator threads. The
+ * other threads are stopped, their registers were dumped on their stacks.
+ */
 void Marker_markProgramStack(Heap *heap, Stack *stack) {
     // Dumps registers into 'regs' which is on stack
     jmp_buf regs;
     setjmp(regs);
     word_t *dummy;
 
-    word_t **current = &dummy;
-    word_t **stackBottom = __stack_bottom;
-
-    while (current <= stackBottom) {
-
-        word_t *stackObject = (*current) - WORDS_IN_OBJECT_HEADER;
-        if (Heap_IsWordInHeap(heap, stackObject)) {
-            Marker_markConservative(heap, stack, stackObject);
-        }
-        current += 1;
+    MutatorThread *self = currentMutatorThread;
+    for (MutatorThread *thread = mutatorThreads.first; thread != NULL;
+         thread = thread->next) {
+        word_t **top = thread == self ? &dummy : thread->stackTop;
+        Marker_markStack(heap, stack, top, thread->stackBottom);
     }
 }
 
@@ -113,19 +345,142 @@ void Marker_markModules(Heap *heap, Stack *stack) {
     int nb_modules = __modules_size;
 
     for (int i = 0; i < nb_modules; i++) {
-        Object *object = Object_FromMutatorAddress(modules[i]);
-        if (heap_isObjectInHeap(heap, object) &&
-            !Object_IsMarked(&object->header)) {
-            Marker_markObject(heap, stack, object);
-        }
+        Marker_markField(heap, stack, &modules[i]);
     }
 }
 
-void Marker_MarkRoots(Heap *heap, Stack *stack) {
-
+/**
+ * Marks the objects referenced by the program stack and the modules and pushes
+ * them to `stack`, without tracing any further.
+ */
+void Marker_ScanRoots(Heap *heap, Stack *stack) {
     Marker_markProgramStack(heap, stack);
 
     Marker_markModules(heap, stack);
+    Trace_Record(&trace, trace_roots_scanned, 0, 0);
+}
+
+/**
+ * Scans the old objects overlapping a dirty line. An object overlapping the
+ * line starts either in it or in one of the marked lines before it.
+ */
+void Marker_scanDirtyLine(Heap *heap, Stack *stack, BlockHeader *blockHeader,
+                          int lineIndex) {
+    word_t *lineStart = Block_GetLineAddress(blockHeader, lineIndex);
+    word_t *lineEnd = lineStart + WORDS_IN_LINE;
+    int first = lineIndex;
+    while (first > 0 && lineIndex - first < (int)MAX_LINES_PER_OBJECT &&
+           Line_IsMarked(Block_GetLineHeader(blockHeader, first - 1))) {
+        first--;
+    }
+    for (int index = first; index <= lineIndex; index++) {
+        LineHeader *lineHeader = Block_GetLineHeader(blockHeader, index);
+        if (!Line_ContainsObject(lineHeader)) {
+            continue;
+        }
+        Object *object = Line_GetFirstObject(lineHeader);
+        word_t *end = Block_GetLineAddress(blockHeader, index) + WORDS_IN_LINE;
+        while (object != NULL && (word_t *)object < end) {
+            Object *next = Object_NextObject(object);
+            word_t *objectEnd =
+                (word_t *)((ubyte_t *)object + Object_Size(&object->header));
+            if (objectEnd > lineStart && (word_t *)object < lineEnd &&
+                Object_IsMarked(object)) {
+                Marker_scanObject(heap, stack, object);
+            }
+            object = next;
+        }
+    }
+}
+
+/**
+ * Scans the old large objects that have dirty chunks, going from one set bit
+ * of the card bitmap to the next and finding the object owning each dirty
+ * chunk with the allocator bitmap. Only the dirty chunks of object arrays are
+ * scanned, other objects are scanned as a whole.
+ */
+void Marker_scanDirtyCards(Heap *heap, Stack *stack) {
+    Bitmap *cards = largeAllocator.cards;
+    ubyte_t *heapEnd = (ubyte_t *)largeAllocator.offset + largeAllocator.size;
+    ubyte_t *card =
+        Bitmap_FindNextSetBit(cards, (ubyte_t *)largeAllocator.offset);
+
+    while (card < heapEnd) {
+        Object *object =
+            (Object *)Bitmap_FindPreviousSetBit(largeAllocator.bitmap, card);
+        ubyte_t *objectEnd = (ubyte_t *)Object_NextLargeObject(object);
+        ubyte_t *next = card + BITMAP_GRANULARITY;
+        if (!Object_IsMarked(object)) {
+            next = objectEnd;
+        } else if (object->rtti->rt.id != __object_array_id) {
+            Marker_scanObject(heap, stack, object);
+            next = objectEnd;
+        } else {
+            word_t **fieldsEnd =
+                (word_t **)((ubyte_t *)object + Object_Size(&object->header));
+            word_t **start = (word_t **)card;
+            word_t **end = (word_t **)next;
+            if (start < (word_t **)object->fields) {
+                start = (word_t **)object->fields;
+            }
+            if (end > fieldsEnd) {
+                end = fieldsEnd;
+            }
+            Marker_scanRange(heap, stack, start, end);
+        }
+        if (next >= heapEnd) {
+            break;
+        }
+        card = Bitmap_FindNextSetBit(cards, next);
+    }
+    Bitmap_ClearAll(cards);
+}
+
+/**
+ * Marks the young objects referenced by old objects, found through the lines
+ * and chunks dirtied by the card-marking write barrier, and pushes them to
+ * `stack`. The dirty lines and chunks are cleared.
+ */
+void Marker_ScanRememberedSet(Heap *heap, Stack *stack) {
+    for (word_t *current = heap->heapStart; current < heap->heapEnd;
+         current += WORDS_IN_BLOCK) {
+        BlockHeader *blockHeader = (BlockHeader *)current;
+        // Lines of unmarked blocks are never dirtied
+        if (!Block_IsMarked(blockHeader)) {
+            continue;
+        }
+        for (int lineIndex = 0; lineIndex < (int)LINE_COUNT; lineIndex++) {
+            LineHeader *lineHeader =
+                Block_GetLineHeader(blockHeader, lineIndex);
+            if (Line_IsDirty(lineHeader)) {
+                Line_ClearDirty(lineHeader);
+                Marker_scanDirtyLine(heap, stack, blockHeader, lineIndex);
+            }
+        }
+    }
+    Marker_scanDirtyCards(heap, stack);
+}
+
+/**
+ * Minor collection with sticky mark bits: the objects that survived the
+ * previous collections are still marked, so only the objects allocated since
+ * then are traced, from the roots and the remembered set.
+ */
+void Marker_MarkYoung(Heap *heap, Stack *stacks) {
+    allocator.markedBlockCount = 0;
+    allocator.markedLineCount = 0;
+
+    Marker_ScanRoots(heap, &stacks[0]);
+    Marker_ScanRememberedSet(heap, &stacks[0]);
+
+    Marker_MarkParallel(heap);
+}
+
+void Marker_MarkRoots(Heap *heap, Stack *stacks) {
+    allocator.markedBlockCount = 0;
+    allocator.markedLineCount = 0;
+
+    Marker_ScanRoots(heap, &stacks[0]);
 
-    Marker_Mark(heap, stack);
+    Marker_MarkParallel(heap);
 }
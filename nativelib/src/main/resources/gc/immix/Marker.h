@@ -4,7 +4,12 @@
 #include "Heap.h"
 #include "datastructures/Stack.h"
 
-void Marker_MarkRoots(Heap *heap, Stack *stack);
+void Marker_MarkRoots(Heap *heap, Stack *stacks);
+void Marker_MarkYoung(Heap *heap, Stack *stacks);
+void Marker_ScanRememberedSet(Heap *heap, Stack *stack);
+void Marker_ScanRoots(Heap *heap, Stack *stack);
+void Marker_MarkParallel(Heap *heap);
 void Marker_Mark(Heap *heap, Stack *stack);
+void Marker_ScanEntry(Heap *heap, Stack *stack, Stack_Type *entry);
 
 #endif // IMMIX_MARKER_H
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <sched.h>
+#include "MutatorThreads.h"
+#include "State.h"
+#include "Log.h"
+
+// Same signals as the Boehm GC
+#ifdef __linux__
+#define STOP_SIGNAL SIGPWR
+#define RESUME_SIGNAL SIGXCPU
+#else
+#define STOP_SIGNAL SIGUSR1
+#define RESUME_SIGNAL SIGUSR2
+#endif
+
+/**
+ * Stops the calling thread until the world is resumed. The registers are
+ * dumped on the stack first, so that the collector finds the references they
+ * hold when it scans the stack.
+ */
+NOINLINE void MutatorThread_Stop(MutatorThread *thread) {
+    // `setjmp` mangles some registers, this saves them all in the frame
+    __builtin_unwind_init();
+    jmp_buf regs;
+    setjmp(regs);
+
+    // The resume signal stays blocked until the thread waits for it, so that
+    // it cannot get lost
+    sigset_t blocked;
+    sigset_t waiting;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, RESUME_SIGNAL);
+    pthread_sigmask(SIG_BLOCK, &blocked, &waiting);
+    sigset_t previous = waiting;
+    sigdelset(&waiting, RESUME_SIGNAL);
+
+    thread->stopRequested = false;
+    thread->stackTop = (word_t **)&regs;
+    __atomic_add_fetch(&mutatorThreads.acknowledged, 1, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&mutatorThreads.stopped, __ATOMIC_ACQUIRE)) {
+        sigsuspend(&waiting);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    __atomic_add_fetch(&mutatorThreads.acknowledged, 1, __ATOMIC_RELEASE);
+}
+
+void MutatorThreads_onStopSignal(int signal) {
+    (void)signal;
+    int savedErrno = errno;
+    MutatorThread *thread = currentMutatorThread;
+    if (thread->critical) {
+        thread->stopRequested = true;
+    } else {
+        MutatorThread_Stop(thread);
+    }
+    errno = savedErrno;
+}
+
+void MutatorThreads_onResumeSignal(int signal) { (void)signal; }
+
+void MutatorThreads_Init(MutatorThreads *threads) {
+    pthread_mutex_init(&threads->lock, NULL);
+    threads->first = NULL;
+    threads->stopped = false;
+    threads->acknowledged = 0;
+    threads->stoppedAt = 0;
+
+    struct sigaction action;
+    action.sa_flags = SA_RESTART;
+    sigfillset(&action.sa_mask);
+    // Faults must still reach their handlers while the thread is stopped
+    sigdelset(&action.sa_mask, SIGSEGV);
+    sigdelset(&action.sa_mask, SIGBUS);
+    action.sa_handler = MutatorThreads_onStopSignal;
+    if (sigaction(STOP_SIGNAL, &action, NULL) != 0) {
+        printf("Failed to install the GC signal handlers\n");
+        exit(1);
+    }
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = MutatorThreads_onResumeSignal;
+    sigaction(RESUME_SIGNAL, &action, NULL);
+}
+
+/**
+ * Registers the calling thread, whose stack starts at `stackBottom`. The
+ * thread has to be registered before it allocates or stores a reference.
+ */
+MutatorThread *MutatorThreads_Register(MutatorThreads *threads,
+                                       word_t **stackBottom) {
+    MutatorThread *thread = malloc(sizeof(MutatorThread));
+    if (thread == NULL) {
+        printf("Out of memory for the mutator threads\n");
+        exit(1);
+    }
+    thread->thread = pthread_self();
+    thread->stackTop = NULL;
+    thread->stackBottom = stackBottom;
+    Allocator_InitTlab(&allocator, &thread->tlab);
+    thread->logBuffer = NULL;
+    thread->critical = false;
+    thread->stopRequested = false;
+
+    MutatorThreads_Lock(threads);
+    thread->next = threads->first;
+    threads->first = thread;
+    currentMutatorThread = thread;
+    MutatorThreads_Unlock(threads);
+    return thread;
+}
+
+/**
+ * Removes the calling thread from the registry, it must not use the heap
+ * afterwards. What is left in its buffers is reclaimed by the next sweep.
+ */
+void MutatorThreads_Unregister(MutatorThreads *threads,
+                               MutatorThread *thread) {
+    MutatorThreads_Lock(threads);
+    MutatorThread **current = &threads->first;
+    while (*current != thread) {
+        current = &(*current)->next;
+    }
+    *current = thread->next;
+    currentMutatorThread = NULL;
+    // The blocks of the buffer are swept with the rest of the heap
+    Allocator_RecordObjects(&thread->tlab);
+    stats.allocatedBytes += thread->tlab.allocatedBytes;
+    // The objects logged during a concurrent mark still need to be traced
+    WriteBarrier_Flush(&thread->logBuffer);
+    MutatorThreads_Unlock(threads);
+    free(thread);
+}
+
+void MutatorThreads_Lock(MutatorThreads *threads) {
+    pthread_mutex_lock(&threads->lock);
+}
+
+void MutatorThreads_Unlock(MutatorThreads *threads) {
+    pthread_mutex_unlock(&threads->lock);
+}
+
+/**
+ * Sends `signal` to every thread but the calling one, and waits until they
+ * all acknowledged it.
+ */
+void MutatorThreads_signalAll(MutatorThreads *threads, int signal) {
+    MutatorThread *self = currentMutatorThread;
+    int count = 0;
+    for (MutatorThread *thread = threads->first; thread != NULL;
+         thread = thread->next) {
+        if (thread != self) {
+            pthread_kill(thread->thread, signal);
+            count++;
+        }
+    }
+    while (__atomic_load_n(&threads->acknowledged, __ATOMIC_ACQUIRE) < count) {
+        sched_yield();
+    }
+}
+
+/**
+ * Stops every registered thread but the calling one, which must hold the
+ * lock. Once this returns, the stacks of the other threads can be scanned,
+ * none of them is in a critical region and the line headers record all the
+ * objects they allocated, which are added to the statistics.
+ */
+void MutatorThreads_StopTheWorld(MutatorThreads *threads) {
+    assert(!threads->stopped);
+    Trace_Record(&trace, trace_pause_start, 0, 0);
+    threads->stoppedAt = Stats_Now();
+    threads->acknowledged = 0;
+    __atomic_store_n(&threads->stopped, true, __ATOMIC_RELEASE);
+    MutatorThreads_signalAll(threads, STOP_SIGNAL);
+    for (MutatorThread *thread = threads->first; thread != NULL;
+         thread = thread->next) {
+        Allocator_RecordObjects(&thread->tlab);
+        stats.allocatedBytes += thread->tlab.allocatedBytes;
+        thread->tlab.allocatedBytes = 0;
+    }
+}
+
+void MutatorThreads_ResumeTheWorld(MutatorThreads *threads) {
+    assert(threads->stopped);
+    threads->acknowledged = 0;
+    __atomic_store_n(&threads->stopped, false, __ATOMIC_RELEASE);
+    MutatorThreads_signalAll(threads, RESUME_SIGNAL);
+    Stats_RecordPause(&stats, threads->stoppedAt);
+    Trace_Record(&trace, trace_pause_end, 0, 0);
+}
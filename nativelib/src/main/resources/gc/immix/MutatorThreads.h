@@ -0,0 +1,103 @@
+#ifndef IMMIX_MUTATORTHREADS_H
+#define IMMIX_MUTATORTHREADS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "GCTypes.h"
+#include "Allocator.h"
+#include "WriteBarrier.h"
+#include "headers/ObjectHeader.h"
+
+/**
+ * Thread of the program that allocates in the heap.
+ *
+ * A thread is stopped for collections by a signal, unless it is in a critical
+ * region where its allocation buffer or write barrier buffer is inconsistent,
+ * or where it stores a reference past the write barrier. The signal then only
+ * leaves a request, and the thread stops itself when it leaves the region.
+ */
+typedef struct MutatorThread {
+    // The allocation fast path and the write barrier inlined by the compiler
+    // access the flags and the cursor and limit of the buffer, they have to
+    // stay first
+    bool critical;
+    bool stopRequested;
+    Tlab tlab;
+    struct MutatorThread *next;
+    pthread_t thread;
+    // The stack is scanned from `stackTop`, recorded when the thread stops,
+    // to `stackBottom`
+    word_t **stackTop;
+    word_t **stackBottom;
+    LogBuffer *logBuffer;
+} MutatorThread;
+
+// Layouts that the code inlined by the compiler relies on, see `Lower.scala`
+_Static_assert(offsetof(MutatorThread, critical) == 0 &&
+                   offsetof(MutatorThread, stopRequested) == 1,
+               "The inlined code expects the flags first in the thread");
+_Static_assert(offsetof(MutatorThread, tlab.cursor) == WORD_SIZE &&
+                   offsetof(MutatorThread, tlab.limit) == 2 * WORD_SIZE,
+               "The inlined code expects the cursor and limit after the flags");
+_Static_assert(offsetof(ObjectHeader, size) == 0 &&
+                   offsetof(ObjectHeader, type) == 4 &&
+                   offsetof(ObjectHeader, flag) == 5 &&
+                   object_standard == 1 && object_allocated == 1,
+               "The inlined code writes a different object header");
+_Static_assert(offsetof(Object, rtti) == OBJECT_HEADER_SIZE &&
+                   WORD_SIZE_BITS == 3,
+               "The inlined code expects the rtti after an 8 bytes header");
+
+/**
+ * Registry of the mutator threads.
+ *
+ * The lock is held by the thread that collects, and by the allocation slow
+ * paths that need the whole heap. Thus only the thread that holds it stops
+ * the others, and threads do not register or leave during a collection.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    MutatorThread *first;
+    // Set from the time the world is stopped until it is resumed
+    bool stopped;
+    // Number of threads that stopped or resumed since the last request
+    int acknowledged;
+    // When the world was last stopped, to time the pauses
+    uint64_t stoppedAt;
+} MutatorThreads;
+
+void MutatorThreads_Init(MutatorThreads *threads);
+MutatorThread *MutatorThreads_Register(MutatorThreads *threads,
+                                       word_t **stackBottom);
+void MutatorThreads_Unregister(MutatorThreads *threads,
+                               MutatorThread *thread);
+void MutatorThreads_Lock(MutatorThreads *threads);
+void MutatorThreads_Unlock(MutatorThreads *threads);
+void MutatorThreads_StopTheWorld(MutatorThreads *threads);
+void MutatorThreads_ResumeTheWorld(MutatorThreads *threads);
+void MutatorThread_Stop(MutatorThread *thread);
+
+/**
+ * Enters a region in which the thread cannot be stopped. Only the thread
+ * itself reads and writes the flags, the signal handler runs on it.
+ */
+static inline void MutatorThread_EnterCritical(MutatorThread *thread) {
+    thread->critical = true;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+/**
+ * Leaves a critical region, and stops the thread if a collection asked for
+ * it in the meantime.
+ */
+static inline void MutatorThread_LeaveCritical(MutatorThread *thread) {
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    thread->critical = false;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    if (thread->stopRequested) {
+        MutatorThread_Stop(thread);
+    }
+}
+
+#endif // IMMIX_MUTATORTHREADS_H
@@ -6,6 +6,11 @@
 #include "Log.h"
 #include "utils/MathUtils.h"
 
+// Blocks and lines marked by the current GC thread, see
+// `Object_TakeMarkedCounts`
+static __thread uint64_t markedBlockCount = 0;
+static __thread uint64_t markedLineCount = 0;
+
 Object *Object_NextLargeObject(Object *object) {
     size_t size = Object_ChunkSize(object);
     assert(size != 0);
@@ -31,40 +36,6 @@ static inline bool isWordAligned(word_t *word) {
     return ((word_t)word & WORD_INVERSE_MASK) == (word_t)word;
 }
 
-Object *Object_getInLine(BlockHeader *blockHeader, int lineIndex,
-                         word_t *word) {
-    assert(Line_ContainsObject(Block_GetLineHeader(blockHeader, lineIndex)));
-
-    Object *current =
-        Line_GetFirstObject(Block_GetLineHeader(blockHeader, lineIndex));
-    Object *next = Object_NextObject(current);
-
-    word_t *lineEnd =
-        Block_GetLineAddress(blockHeader, lineIndex) + WORDS_IN_LINE;
-
-    while (next != NULL && (word_t *)next < lineEnd && (word_t *)next <= word) {
-        current = next;
-        next = Object_NextObject(next);
-    }
-
-    if (Object_IsAllocated(&current->header) && word >= (word_t *)current &&
-        word < (word_t *)next) {
-#ifdef DEBUG_PRINT
-        if ((word_t *)current != word) {
-            printf("inner pointer: %p object: %p\n", word, current);
-            fflush(stdout);
-        }
-#endif
-        return current;
-    } else {
-#ifdef DEBUG_PRINT
-        printf("ignoring %p\n", word);
-        fflush(stdout);
-#endif
-        return NULL;
-    }
-}
-
 Object *Object_GetObject(word_t *word) {
     BlockHeader *blockHeader = Block_GetBlockHeader(word);
 
@@ -86,17 +57,19 @@ Object *Object_GetObject(word_t *word) {
         word = (word_t *)((word_t)word & WORD_INVERSE_MASK);
     }
 
-    int lineIndex = Block_GetLineIndexFromWord(blockHeader, word);
-    while (lineIndex > 0 &&
-           !Line_ContainsObject(Block_GetLineHeader(blockHeader, lineIndex))) {
-        lineIndex--;
-    }
-
-    if (Line_ContainsObject(Block_GetLineHeader(blockHeader, lineIndex))) {
-        return Object_getInLine(blockHeader, lineIndex, word);
+    // Inner pointers resolve to the closest object starting before them
+    Object *object = (Object *)Block_FindObjectStart(blockHeader, word);
+    if (object != NULL && word < (word_t *)Object_NextObject(object)) {
+#ifdef DEBUG_PRINT
+        if ((word_t *)object != word) {
+            printf("inner pointer: %p object: %p\n", word, object);
+            fflush(stdout);
+        }
+#endif
+        return object;
     } else {
 #ifdef DEBUG_PRINT
-        printf("Word points to empty line %p\n", word);
+        printf("ignoring %p\n", word);
         fflush(stdout);
 #endif
         return NULL;
@@ -104,17 +77,14 @@ Object *Object_GetObject(word_t *word) {
 }
 
 Object *Object_getLargeInnerPointer(LargeAllocator *allocator, word_t *word) {
-    word_t *current = (word_t *)((word_t)word & LARGE_BLOCK_MASK);
-
-    while (!Bitmap_GetBit(allocator->bitmap, (ubyte_t *)current)) {
-        current -= LARGE_BLOCK_SIZE / WORD_SIZE;
-    }
-
-    Object *object = (Object *)current;
+    // The first chunk of the large heap always has its bit set
+    Object *object =
+        (Object *)Bitmap_FindPreviousSetBit(allocator->bitmap, (ubyte_t *)word);
+    assert(object != NULL);
     if (word < (word_t *)object + Object_ChunkSize(object) / WORD_SIZE &&
-        object->rtti != NULL) {
+        !Object_IsFree(&object->header)) {
 #ifdef DEBUG_PRINT
-        printf("large inner pointer: %p, object: %p\n", word, objectHeader);
+        printf("large inner pointer: %p, object: %p\n", word, object);
         fflush(stdout);
 #endif
         return object;
@@ -140,31 +110,105 @@ Object *Object_GetLargeObject(LargeAllocator *allocator, word_t *word) {
     }
 }
 
-void Object_Mark(Object *object) {
-    // Mark the object itself
-    Object_MarkObjectHeader(&object->header);
-
-    if (!Object_IsLargeObject(&object->header)) {
-        // Mark the block
-        BlockHeader *blockHeader = Block_GetBlockHeader((word_t *)object);
-        Block_Mark(blockHeader);
-
-        // Mark all Lines
-        int startIndex =
-            Block_GetLineIndexFromWord(blockHeader, (word_t *)object);
-        word_t *lastWord = (word_t *)Object_NextObject(object) - 1;
-        int endIndex = Block_GetLineIndexFromWord(blockHeader, lastWord);
-        assert(startIndex >= 0 && startIndex < LINE_COUNT);
-        assert(endIndex >= 0 && endIndex < LINE_COUNT);
-        assert(startIndex <= endIndex);
-        for (int i = startIndex; i <= endIndex; i++) {
-            LineHeader *lineHeader = Block_GetLineHeader(blockHeader, i);
-            Line_Mark(lineHeader);
+/**
+ * Marks the block and the lines of a small object.
+ */
+void Object_MarkLines(Object *object) {
+    BlockHeader *blockHeader = Block_GetBlockHeader((word_t *)object);
+    if (Block_Mark(blockHeader)) {
+        markedBlockCount++;
+    }
+
+    int startIndex = Block_GetLineIndexFromWord(blockHeader, (word_t *)object);
+    word_t *lastWord = (word_t *)Object_NextObject(object) - 1;
+    int endIndex = Block_GetLineIndexFromWord(blockHeader, lastWord);
+    assert(startIndex >= 0 && startIndex < LINE_COUNT);
+    assert(endIndex >= 0 && endIndex < LINE_COUNT);
+    assert(startIndex <= endIndex);
+    for (int i = startIndex; i <= endIndex; i++) {
+        LineHeader *lineHeader = Block_GetLineHeader(blockHeader, i);
+        if (Line_Mark(lineHeader)) {
+            markedLineCount++;
         }
     }
 }
 
+/**
+ * Marks the object together with its block and lines.
+ *
+ * @return `true` if the object was marked by this call, `false` if another GC
+ * thread marked it first.
+ */
+bool Object_Mark(Object *object) {
+    if (Object_IsLargeObject(&object->header)) {
+        return Bitmap_SetBitAtomic(largeAllocator.marks, (ubyte_t *)object);
+    }
+    if (!Block_MarkObject(Block_GetBlockHeader((word_t *)object),
+                          (word_t *)object)) {
+        return false;
+    }
+    Object_MarkLines(object);
+    return true;
+}
+
+/**
+ * Same as `Object_Mark` without atomic operations, for a single GC thread with
+ * the world stopped.
+ */
+bool Object_MarkSerial(Object *object) {
+    if (Object_IsLargeObject(&object->header)) {
+        if (Bitmap_GetBit(largeAllocator.marks, (ubyte_t *)object)) {
+            return false;
+        }
+        Bitmap_SetBit(largeAllocator.marks, (ubyte_t *)object);
+        return true;
+    }
+    if (!Block_MarkObjectSerial(Block_GetBlockHeader((word_t *)object),
+                                (word_t *)object)) {
+        return false;
+    }
+    Object_MarkLines(object);
+    return true;
+}
+
+/**
+ * Adds the number of blocks and lines marked by the calling GC thread to
+ * `blocks` and `lines`, and resets the thread's counts.
+ */
+void Object_TakeMarkedCounts(uint64_t *blocks, uint64_t *lines) {
+    __atomic_add_fetch(blocks, markedBlockCount, __ATOMIC_RELAXED);
+    __atomic_add_fetch(lines, markedLineCount, __ATOMIC_RELAXED);
+    markedBlockCount = 0;
+    markedLineCount = 0;
+}
+
 size_t Object_ChunkSize(Object *object) {
     return MathUtils_RoundToNextMultiple(Object_Size(&object->header),
                                          MIN_BLOCK_SIZE);
 }
+
+/**
+ * Copies the name of the class to `buffer`, at most `size - 1` characters and
+ * a terminating zero. The name is a `java.lang.String`: an object with the
+ * character array, the offset and the count as its first fields. The
+ * characters of the array start after its rtti and length, the ones outside
+ * of ASCII are replaced with `?`.
+ *
+ * @return the number of characters copied
+ */
+size_t Object_ClassName(Rtti *rtti, char *buffer, size_t size) {
+    word_t **name = (word_t **)rtti->rt.name;
+    if (name == NULL) {
+        return (size_t)snprintf(buffer, size, "<unknown>");
+    }
+    ubyte_t *value = (ubyte_t *)name[1];
+    int32_t offset = *(int32_t *)&name[2];
+    int32_t count = *((int32_t *)&name[2] + 1);
+    uint16_t *chars = (uint16_t *)(value + 2 * WORD_SIZE) + offset;
+    size_t length = 0;
+    for (int32_t i = 0; i < count && length + 1 < size; i++) {
+        buffer[length++] = chars[i] < 0x80 ? (char)chars[i] : '?';
+    }
+    buffer[length] = '\0';
+    return length;
+}
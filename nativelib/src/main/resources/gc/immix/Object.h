@@ -2,13 +2,31 @@
 #define IMMIX_OBJECT_H
 
 #include "headers/ObjectHeader.h"
+#include "headers/BlockHeader.h"
 #include "LargeAllocator.h"
+#include "State.h"
 
 Object *Object_NextLargeObject(Object *objectHeader);
 Object *Object_NextObject(Object *objectHeader);
 Object *Object_GetObject(word_t *address);
 Object *Object_GetLargeObject(LargeAllocator *largeAllocator, word_t *address);
-void Object_Mark(Object *objectHeader);
+bool Object_Mark(Object *objectHeader);
+bool Object_MarkSerial(Object *object);
+void Object_MarkLines(Object *object);
+void Object_TakeMarkedCounts(uint64_t *blocks, uint64_t *lines);
 size_t Object_ChunkSize(Object *objectHeader);
+size_t Object_ClassName(Rtti *rtti, char *buffer, size_t size);
+
+/**
+ * Small objects are marked in the mark bitmap of their block, large objects
+ * in the mark bitmap of the large heap.
+ */
+static inline bool Object_IsMarked(Object *object) {
+    if (Object_IsLargeObject(&object->header)) {
+        return Bitmap_GetBit(largeAllocator.marks, (ubyte_t *)object);
+    }
+    return Block_IsObjectMarked(Block_GetBlockHeader((word_t *)object),
+                                (word_t *)object);
+}
 
 #endif // IMMIX_OBJECT_H
@@ -0,0 +1,258 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Profiler.h"
+#include "Object.h"
+#include "../../libunwind/include-libunwind/libunwind.h"
+
+// State of the random generator of the calling thread, 0 until it is seeded
+static __thread uint64_t profilerRandom = 0;
+
+void Profiler_Init(Profiler *profiler, size_t interval) {
+    profiler->enabled = true;
+    profiler->interval = interval;
+    pthread_mutex_init(&profiler->lock, NULL);
+    profiler->capacity = PROFILER_INITIAL_CAPACITY;
+    profiler->count = 0;
+    profiler->entries = calloc(profiler->capacity, sizeof(ProfilerEntry));
+    if (profiler->entries == NULL) {
+        profiler->enabled = false;
+    }
+}
+
+/**
+ * Uniform random number in `(0, 1]`, from a xorshift generator per thread.
+ */
+double Profiler_random() {
+    uint64_t x = profilerRandom;
+    if (x == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        x = ((uint64_t)now.tv_nsec << 32) ^ (uint64_t)&profilerRandom ^
+            (uint64_t)now.tv_sec;
+        x |= 1;
+    }
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    profilerRandom = x;
+    return ((x * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0) +
+           (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Number of bytes until the next sample, a multiple of the word size. With
+ * the profiler disabled, no sample is ever taken.
+ */
+size_t Profiler_NextInterval(Profiler *profiler) {
+    if (!profiler->enabled) {
+        return SIZE_MAX;
+    }
+    double distance = -log(Profiler_random()) * profiler->interval;
+    size_t words = (size_t)(distance / WORD_SIZE) + 1;
+    return words * WORD_SIZE;
+}
+
+/**
+ * Whether a large object of `size` bytes is sampled. The distances between
+ * samples are memoryless, thus the large objects can be sampled on their own
+ * with the probability that a sample falls in them.
+ */
+bool Profiler_SampleLarge(Profiler *profiler, size_t size) {
+    if (!profiler->enabled) {
+        return false;
+    }
+    return Profiler_random() > exp(-(double)size / profiler->interval);
+}
+
+uint64_t Profiler_hash(Rtti *rtti, void **frames, uint32_t depth) {
+    // FNV-1a over the words of the key
+    uint64_t hash = 14695981039346656037ULL;
+    hash = (hash ^ (uint64_t)rtti) * 1099511628211ULL;
+    for (uint32_t i = 0; i < depth; i++) {
+        hash = (hash ^ (uint64_t)frames[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Finds the entry of the key, or the empty slot where it goes.
+ */
+ProfilerEntry *Profiler_find(ProfilerEntry *entries, size_t capacity,
+                             uint64_t hash, Rtti *rtti, void **frames,
+                             uint32_t depth) {
+    size_t index = hash & (capacity - 1);
+    while (true) {
+        ProfilerEntry *entry = &entries[index];
+        if (entry->count == 0 ||
+            (entry->hash == hash && entry->rtti == rtti &&
+             entry->depth == depth &&
+             memcmp(entry->frames, frames, depth * sizeof(void *)) == 0)) {
+            return entry;
+        }
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+/**
+ * Doubles the capacity of the table, called with the lock held.
+ *
+ * @return `false` if there is no memory left for it
+ */
+bool Profiler_grow(Profiler *profiler) {
+    size_t capacity = profiler->capacity * 2;
+    ProfilerEntry *entries = calloc(capacity, sizeof(ProfilerEntry));
+    if (entries == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < profiler->capacity; i++) {
+        ProfilerEntry *entry = &profiler->entries[i];
+        if (entry->count != 0) {
+            *Profiler_find(entries, capacity, entry->hash, entry->rtti,
+                           entry->frames, entry->depth) = *entry;
+        }
+    }
+    free(profiler->entries);
+    profiler->entries = entries;
+    profiler->capacity = capacity;
+    return true;
+}
+
+/**
+ * Records a sampled allocation of `size` bytes with the stack of the calling
+ * thread. Each sample stands for `size / p` bytes, where `p` is the chance
+ * that a sample falls in an allocation of that size.
+ */
+NOINLINE void Profiler_Record(Profiler *profiler, Rtti *rtti, size_t size) {
+    void *frames[PROFILER_MAX_FRAMES];
+    uint32_t depth = 0;
+    unw_cursor_t cursor;
+    unw_context_t context;
+    unw_getcontext(&context);
+    unw_init_local(&cursor, &context);
+    while (depth < PROFILER_MAX_FRAMES && unw_step(&cursor) > 0) {
+        unw_word_t pc;
+        unw_get_reg(&cursor, UNW_REG_IP, &pc);
+        if (pc == 0) {
+            break;
+        }
+        frames[depth++] = (void *)pc;
+    }
+    uint64_t hash = Profiler_hash(rtti, frames, depth);
+    double probability = 1 - exp(-(double)size / profiler->interval);
+
+    pthread_mutex_lock(&profiler->lock);
+    if ((profiler->count + 1) * 2 > profiler->capacity &&
+        !Profiler_grow(profiler)) {
+        pthread_mutex_unlock(&profiler->lock);
+        return;
+    }
+    ProfilerEntry *entry = Profiler_find(profiler->entries, profiler->capacity,
+                                         hash, rtti, frames, depth);
+    if (entry->count == 0) {
+        entry->rtti = rtti;
+        entry->hash = hash;
+        entry->depth = depth;
+        memcpy(entry->frames, frames, depth * sizeof(void *));
+        profiler->count++;
+    }
+    entry->count++;
+    entry->bytes += size;
+    entry->estimatedBytes += size / probability;
+    pthread_mutex_unlock(&profiler->lock);
+}
+
+void Profiler_writeClassName(FILE *file, Rtti *rtti) {
+    char name[CLASS_NAME_MAX_LENGTH];
+    size_t length = Object_ClassName(rtti, name, sizeof(name));
+    for (size_t i = 0; i < length; i++) {
+        // Frame separators and spaces would break the folded format
+        char c = name[i];
+        fputc(c == ';' || c == ' ' ? '_' : c, file);
+    }
+}
+
+void Profiler_writeFrame(FILE *file, unw_cursor_t *cursor, void *frame) {
+    char name[256];
+    unw_word_t offset;
+    if (unw_set_reg(cursor, UNW_REG_IP, (unw_word_t)frame) == 0 &&
+        unw_get_proc_name(cursor, name, sizeof(name), &offset) == 0) {
+        fprintf(file, "%s", name);
+    } else {
+        fprintf(file, "0x%lx", (unsigned long)frame);
+    }
+}
+
+/**
+ * Folded stacks, one line per entry, from the outermost frame to the class of
+ * the objects, followed by the estimated number of bytes.
+ */
+void Profiler_writeFolded(Profiler *profiler, FILE *file) {
+    unw_cursor_t cursor;
+    unw_context_t context;
+    unw_getcontext(&context);
+    unw_init_local(&cursor, &context);
+    for (size_t i = 0; i < profiler->capacity; i++) {
+        ProfilerEntry *entry = &profiler->entries[i];
+        if (entry->count == 0) {
+            continue;
+        }
+        for (uint32_t frame = entry->depth; frame > 0; frame--) {
+            Profiler_writeFrame(file, &cursor, entry->frames[frame - 1]);
+            fputc(';', file);
+        }
+        Profiler_writeClassName(file, entry->rtti);
+        fprintf(file, " %llu\n", (unsigned long long)entry->estimatedBytes);
+    }
+}
+
+/**
+ * Legacy heap profile that pprof reads, with the mappings of the process to
+ * symbolize the addresses. pprof scales the samples with the interval itself,
+ * the classes are left out.
+ */
+void Profiler_writePprof(Profiler *profiler, FILE *file) {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < profiler->capacity; i++) {
+        count += profiler->entries[i].count;
+        bytes += profiler->entries[i].bytes;
+    }
+    fprintf(file, "heap profile: 0: 0 [%llu: %llu] @ heap_v2/%zu\n",
+            (unsigned long long)count, (unsigned long long)bytes,
+            profiler->interval);
+    for (size_t i = 0; i < profiler->capacity; i++) {
+        ProfilerEntry *entry = &profiler->entries[i];
+        if (entry->count == 0) {
+            continue;
+        }
+        fprintf(file, "0: 0 [%llu: %llu] @", (unsigned long long)entry->count,
+                (unsigned long long)entry->bytes);
+        for (uint32_t frame = 0; frame < entry->depth; frame++) {
+            fprintf(file, " %p", entry->frames[frame]);
+        }
+        fputc('\n', file);
+    }
+
+    fprintf(file, "\nMAPPED_LIBRARIES:\n");
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps != NULL) {
+        char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), maps)) > 0) {
+            fwrite(buffer, 1, read, file);
+        }
+        fclose(maps);
+    }
+}
+
+void Profiler_Write(Profiler *profiler, FILE *file, ProfilerFormat format) {
+    pthread_mutex_lock(&profiler->lock);
+    if (format == profiler_format_folded) {
+        Profiler_writeFolded(profiler, file);
+    } else {
+        Profiler_writePprof(profiler, file);
+    }
+    pthread_mutex_unlock(&profiler->lock);
+}
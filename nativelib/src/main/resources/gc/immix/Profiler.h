@@ -0,0 +1,52 @@
+#ifndef IMMIX_PROFILER_H
+#define IMMIX_PROFILER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "GCTypes.h"
+#include "Constants.h"
+#include "headers/ObjectHeader.h"
+
+/**
+ * Allocation samples that share a class and a stack.
+ */
+typedef struct {
+    Rtti *rtti;
+    uint64_t hash;
+    uint32_t depth;
+    uint64_t count;
+    uint64_t bytes;
+    // Estimate of the bytes allocated in total, see `Profiler_Record`
+    double estimatedBytes;
+    void *frames[PROFILER_MAX_FRAMES];
+} ProfilerEntry;
+
+/**
+ * Sampling allocation profiler. On average one allocation is sampled every
+ * `interval` bytes, the distance between two samples is drawn from an
+ * exponential distribution so that every byte has the same chance of being
+ * sampled. The samples are aggregated in an open addressing hash table.
+ */
+typedef struct {
+    bool enabled;
+    size_t interval;
+    pthread_mutex_t lock;
+    ProfilerEntry *entries;
+    size_t capacity;
+    size_t count;
+} Profiler;
+
+typedef enum {
+    profiler_format_pprof = 0x0,
+    profiler_format_folded = 0x1,
+} ProfilerFormat;
+
+void Profiler_Init(Profiler *profiler, size_t interval);
+size_t Profiler_NextInterval(Profiler *profiler);
+bool Profiler_SampleLarge(Profiler *profiler, size_t size);
+void Profiler_Record(Profiler *profiler, Rtti *rtti, size_t size);
+void Profiler_Write(Profiler *profiler, FILE *file, ProfilerFormat format);
+
+#endif // IMMIX_PROFILER_H
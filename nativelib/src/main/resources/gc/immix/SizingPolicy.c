@@ -0,0 +1,134 @@
+#include "SizingPolicy.h"
+#include "Constants.h"
+#include "State.h"
+
+void SizingPolicy_Init(SizingPolicy *policy,
+                       SizingPolicy_TargetBlockCount targetBlockCount) {
+    policy->targetBlockCount = targetBlockCount;
+    policy->gcTimeRatio = DEFAULT_GC_TIME_RATIO;
+    policy->pauseTargetNanos = 0;
+    policy->cycleStart = Stats_Now();
+    policy->pauseNanos = 0;
+    policy->allocatedBytes = 0;
+    policy->liveBytes = 0;
+    policy->measured = false;
+}
+
+static inline void SizingPolicy_smooth(SizingPolicy *policy, double *average,
+                                       double value) {
+    if (policy->measured) {
+        *average = *average * (1 - SIZING_POLICY_WEIGHT) +
+                   value * SIZING_POLICY_WEIGHT;
+    } else {
+        *average = value;
+    }
+}
+
+/**
+ * Measures the cycle that ends with the collection that was just swept. Must
+ * be called with the world stopped, the pause of the collection is only added
+ * to `stats` once the world resumes.
+ */
+void SizingPolicy_Record(SizingPolicy *policy, Heap *heap) {
+    uint64_t now = Stats_Now();
+    uint64_t pause = now - mutatorThreads.stoppedAt;
+    uint64_t gcNanos = pause;
+    if (stats.pauseNanos > policy->pauseNanos) {
+        gcNanos += stats.pauseNanos - policy->pauseNanos;
+    }
+    uint64_t wallNanos = now - policy->cycleStart;
+    if (wallNanos <= gcNanos) {
+        wallNanos = gcNanos + 1;
+    }
+    uint64_t allocatedBytes = stats.allocatedBytes - policy->allocatedBytes;
+    double survivalRate = 0;
+    if (allocatedBytes > 0 && heap->smallLiveBytes > policy->liveBytes) {
+        survivalRate =
+            (double)(heap->smallLiveBytes - policy->liveBytes) / allocatedBytes;
+        if (survivalRate > 1) {
+            survivalRate = 1;
+        }
+    }
+
+    SizingPolicy_smooth(policy, &policy->gcNanos, gcNanos);
+    SizingPolicy_smooth(policy, &policy->gcTimeFraction,
+                        (double)gcNanos / wallNanos);
+    SizingPolicy_smooth(policy, &policy->allocationRate,
+                        (double)allocatedBytes / (wallNanos - gcNanos));
+    SizingPolicy_smooth(policy, &policy->survivalRate, survivalRate);
+    SizingPolicy_smooth(policy, &policy->pause, pause);
+    policy->measured = true;
+
+    policy->cycleStart = now;
+    // The rest of the pause counts towards the next cycle
+    policy->pauseNanos = stats.pauseNanos + pause;
+    policy->allocatedBytes = stats.allocatedBytes;
+    policy->liveBytes = heap->smallLiveBytes;
+}
+
+/**
+ * The original rule: grows the heap by its growth rate when less than half of
+ * the blocks are free or too many are unavailable, see
+ * `Allocator_ShouldGrow`. Shrinks it when more than `SHRINK_THRESHOLD` of the
+ * blocks are free, down to `SHRINK_HEADROOM` free blocks per used block.
+ */
+uint64_t SizingPolicy_Occupancy(SizingPolicy *policy, Heap *heap) {
+    (void)policy;
+    if (Allocator_ShouldGrow(&allocator)) {
+        double growth;
+        if (heap->smallHeapSize < EARLY_GROWTH_THRESHOLD) {
+            growth = heap->earlyGrowthRate;
+        } else {
+            growth = heap->growthRate;
+        }
+        return allocator.blockCount +
+               (uint64_t)(allocator.blockCount * (growth - 1));
+    } else if (allocator.freeBlockCount >
+               allocator.blockCount * SHRINK_THRESHOLD) {
+        uint64_t usedBlockCount =
+            allocator.blockCount - allocator.freeBlockCount;
+        return usedBlockCount * (1 + SHRINK_HEADROOM);
+    }
+    return allocator.blockCount;
+}
+
+/**
+ * Sizes the heap so that the pauses take `gcTimeRatio` of the wall time.
+ *
+ * The pauses of a cycle cost about the same whatever the heap size, as
+ * marking depends on the live memory. The program then has to run for
+ * `gcNanos * (1 - gcTimeRatio) / gcTimeRatio` between two collections, and
+ * allocates `allocationRate` bytes per nanosecond meanwhile. The heap holds
+ * that much free memory on top of the live memory, plus the share of it that
+ * will survive the next collection, so that the next cycle is as long.
+ *
+ * With a pause target, the heap is also kept small enough for the pauses to
+ * meet it, assuming they grow with the heap, as sweeping does. The heap size
+ * changes by at most a factor of `SIZING_POLICY_MAX_STEP` per collection, and
+ * keeps at least `SIZING_POLICY_MIN_FREE` of it free.
+ */
+uint64_t SizingPolicy_Adaptive(SizingPolicy *policy, Heap *heap) {
+    double programNanos =
+        policy->gcNanos * (1 - policy->gcTimeRatio) / policy->gcTimeRatio;
+    double freeBytes = programNanos * policy->allocationRate;
+    double targetBytes =
+        heap->smallLiveBytes + freeBytes * (1 + policy->survivalRate);
+
+    double heapBytes = (double)allocator.blockCount * BLOCK_TOTAL_SIZE;
+    if (policy->pauseTargetNanos != 0 && policy->pause > 0) {
+        double maxBytes = heapBytes * policy->pauseTargetNanos / policy->pause;
+        if (targetBytes > maxBytes) {
+            targetBytes = maxBytes;
+        }
+    }
+    double minBytes = heap->smallLiveBytes / (1 - SIZING_POLICY_MIN_FREE);
+    if (targetBytes < minBytes) {
+        targetBytes = minBytes;
+    }
+    if (targetBytes > heapBytes * SIZING_POLICY_MAX_STEP) {
+        targetBytes = heapBytes * SIZING_POLICY_MAX_STEP;
+    } else if (targetBytes < heapBytes / SIZING_POLICY_MAX_STEP) {
+        targetBytes = heapBytes / SIZING_POLICY_MAX_STEP;
+    }
+    return (uint64_t)((targetBytes + BLOCK_TOTAL_SIZE - 1) / BLOCK_TOTAL_SIZE);
+}
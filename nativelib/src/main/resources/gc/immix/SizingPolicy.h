@@ -0,0 +1,58 @@
+#ifndef IMMIX_SIZINGPOLICY_H
+#define IMMIX_SIZINGPOLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "Heap.h"
+
+typedef struct SizingPolicy SizingPolicy;
+
+/**
+ * Number of blocks the small heap should have after the collection that was
+ * just swept. The heap grows or shrinks towards it, within its memory limit
+ * and its minimum size.
+ */
+typedef uint64_t (*SizingPolicy_TargetBlockCount)(SizingPolicy *policy,
+                                                   Heap *heap);
+
+/**
+ * Decides the size of the small heap after every full collection, see
+ * `Heap_Recycle`. The large heap grows on demand.
+ *
+ * The measurements are taken over the cycle that ends with the collection:
+ * the program time since the previous decision, and the pauses in it. They
+ * are smoothed over the last cycles.
+ */
+struct SizingPolicy {
+    SizingPolicy_TargetBlockCount targetBlockCount;
+    // Targets of `SizingPolicy_Adaptive`
+    double gcTimeRatio;
+    uint64_t pauseTargetNanos;
+    // End of the previous cycle, with the counters of `stats` and the live
+    // memory of the small heap then
+    uint64_t cycleStart;
+    uint64_t pauseNanos;
+    uint64_t allocatedBytes;
+    uint64_t liveBytes;
+    // Whether the smoothed measurements below hold a first value
+    bool measured;
+    // Pause time per cycle, in nanoseconds
+    double gcNanos;
+    // Share of the wall time spent in pauses
+    double gcTimeFraction;
+    // Bytes allocated per nanosecond of program time
+    double allocationRate;
+    // Share of the bytes allocated during a cycle that survive it
+    double survivalRate;
+    // Pause of the collection that ends the cycle, in nanoseconds
+    double pause;
+};
+
+void SizingPolicy_Init(SizingPolicy *policy,
+                       SizingPolicy_TargetBlockCount targetBlockCount);
+void SizingPolicy_Record(SizingPolicy *policy, Heap *heap);
+
+uint64_t SizingPolicy_Occupancy(SizingPolicy *policy, Heap *heap);
+uint64_t SizingPolicy_Adaptive(SizingPolicy *policy, Heap *heap);
+
+#endif // IMMIX_SIZINGPOLICY_H
@@ -17,16 +17,13 @@ bool StackOverflowHandler_overflowBlockScan(BlockHeader *block, Heap *heap,
 
 void StackOverflowHandler_CheckForOverflow() {
     if (overflow) {
+        Trace_Record(&trace, trace_overflow_rescan_start, 0, 0);
         // Set overflow address to the first word of the heap
         currentOverflowAddress = heap.heapStart;
         overflow = false;
-        Stack_DoubleSize(&stack);
-
-#ifdef PRINT_STACK_OVERFLOW
-        printf("Stack grew to %zu bytes\n",
-               stack->nb_words * sizeof(Stack_Type));
-        fflush(stdout);
-#endif
+        // The stacks only overflow when they cannot grow anymore, the
+        // objects are found one at a time
+        Stack *stack = &stacks[0];
 
         word_t *largeHeapEnd = heap.largeHeapEnd;
         // Continue while we don' hit the end of the large heap.
@@ -38,16 +35,17 @@ void StackOverflowHandler_CheckForOverflow() {
                 // If no object was found in the small heap, move on to large
                 // heap
                 if (!StackOverflowHandler_smallHeapOverflowHeapScan(&heap,
-                                                                    &stack)) {
+                                                                    stack)) {
                     currentOverflowAddress = heap.largeHeapStart;
                 }
             } else {
-                StackOverflowHandler_largeHeapOverflowHeapScan(&heap, &stack);
+                StackOverflowHandler_largeHeapOverflowHeapScan(&heap, stack);
             }
 
             // At every iteration when a object is found, trace it
-            Marker_Mark(&heap, &stack);
+            Marker_Mark(&heap, stack);
         }
+        Trace_Record(&trace, trace_overflow_rescan_end, 0, 0);
     }
 }
 
@@ -69,8 +67,7 @@ bool StackOverflowHandler_smallHeapOverflowHeapScan(Heap *heap, Stack *stack) {
 
 bool StackOverflowHandler_overflowMark(Heap *heap, Stack *stack,
                                        Object *object) {
-    ObjectHeader *objectHeader = &object->header;
-    if (Object_IsMarked(objectHeader)) {
+    if (Object_IsMarked(object)) {
         if (object->rtti->rt.id == __object_array_id) {
             size_t size =
                 Object_Size(&object->header) - OBJECT_HEADER_SIZE - WORD_SIZE;
@@ -79,8 +76,8 @@ bool StackOverflowHandler_overflowMark(Heap *heap, Stack *stack,
                 word_t *field = object->fields[i];
                 Object *fieldObject = Object_FromMutatorAddress(field);
                 if (heap_isObjectInHeap(heap, fieldObject) &&
-                    !Object_IsMarked(&fieldObject->header)) {
-                    Stack_Push(stack, object);
+                    !Object_IsMarked(fieldObject)) {
+                    Stack_Push(stack, object, 0);
                     return true;
                 }
             }
@@ -91,8 +88,8 @@ bool StackOverflowHandler_overflowMark(Heap *heap, Stack *stack,
                 word_t *field = object->fields[ptr_map[i]];
                 Object *fieldObject = Object_FromMutatorAddress(field);
                 if (heap_isObjectInHeap(heap, fieldObject) &&
-                    !Object_IsMarked(&fieldObject->header)) {
-                    Stack_Push(stack, object);
+                    !Object_IsMarked(fieldObject)) {
+                    Stack_Push(stack, object, 0);
                     return true;
                 }
                 ++i;
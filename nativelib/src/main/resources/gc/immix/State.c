@@ -1,9 +1,22 @@
 #include "State.h"
 
 Heap heap;
-Stack stack;
+// One mark stack per GC thread, the first one belongs to the collector thread
+Stack *stacks;
+WorkerPool workerPool;
 Allocator allocator;
 LargeAllocator largeAllocator;
+ConcurrentMarker concurrentMarker;
+Evacuation evacuation;
+MutatorThreads mutatorThreads;
+GCStats stats;
+Trace trace;
+// Disabled unless `Profiler_Init` is called
+Profiler profiler;
+// Decides the size of the small heap, see `Heap_Recycle`
+SizingPolicy sizingPolicy;
+// Registry entry of the calling thread, `NULL` if it is not registered
+__thread MutatorThread *currentMutatorThread = NULL;
 
 // For stackoverflow handling
 bool overflow = false;
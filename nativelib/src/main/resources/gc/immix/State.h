@@ -2,11 +2,30 @@
 #define IMMIX_STATE_H
 
 #include "Heap.h"
+#include "WorkerPool.h"
+#include "ConcurrentMarker.h"
+#include "Evacuation.h"
+#include "MutatorThreads.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Profiler.h"
+#include "SizingPolicy.h"
 
 extern Heap heap;
-extern Stack stack;
+extern Stack *stacks;
+extern WorkerPool workerPool;
 extern Allocator allocator;
 extern LargeAllocator largeAllocator;
+extern ConcurrentMarker concurrentMarker;
+extern Evacuation evacuation;
+extern MutatorThreads mutatorThreads;
+// The block counts are the ones of the last sweep. The live memory, from which
+// the freed bytes are derived, is counted in lines for the small heap.
+extern GCStats stats;
+extern Trace trace;
+extern Profiler profiler;
+extern SizingPolicy sizingPolicy;
+extern __thread MutatorThread *currentMutatorThread;
 
 extern bool overflow;
 extern word_t *currentOverflowAddress;
@@ -0,0 +1,22 @@
+#ifndef IMMIX_STATS_H
+#define IMMIX_STATS_H
+
+#include <stdint.h>
+#include <time.h>
+#include "../GCStats.h"
+
+static inline uint64_t Stats_Now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static inline void Stats_RecordPause(GCStats *stats, uint64_t start) {
+    uint64_t pause = Stats_Now() - start;
+    stats->pauseNanos += pause;
+    if (pause > stats->maxPauseNanos) {
+        stats->maxPauseNanos = pause;
+    }
+}
+
+#endif // IMMIX_STATS_H
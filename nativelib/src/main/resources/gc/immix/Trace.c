@@ -0,0 +1,92 @@
+#include <stdbool.h>
+#include <unistd.h>
+#include "Trace.h"
+#include "Stats.h"
+
+// Small number that tells the threads apart in the dump, 0 until it records
+// its first event
+static __thread uint32_t traceThread = 0;
+
+typedef struct {
+    const char *name;
+    // Phase of the Chrome trace event: begin, end or instant
+    char phase;
+} TraceEventFormat;
+
+static const TraceEventFormat traceEventFormats[] = {
+    [trace_collection_start] = {"collection", 'B'},
+    [trace_collection_end] = {"collection", 'E'},
+    [trace_pause_start] = {"pause", 'B'},
+    [trace_pause_end] = {"pause", 'E'},
+    [trace_roots_scanned] = {"roots scanned", 'i'},
+    [trace_mark_done] = {"mark done", 'i'},
+    [trace_sweep_done] = {"sweep done", 'i'},
+    [trace_grow_small_heap] = {"grow small heap", 'i'},
+    [trace_grow_large_heap] = {"grow large heap", 'i'},
+    [trace_overflow_rescan_start] = {"overflow rescan", 'B'},
+    [trace_overflow_rescan_end] = {"overflow rescan", 'E'},
+};
+
+void Trace_Record(Trace *trace, TraceEventType type, uint64_t from,
+                  uint64_t to) {
+    if (traceThread == 0) {
+        traceThread =
+            __atomic_add_fetch(&trace->threadCount, 1, __ATOMIC_RELAXED);
+    }
+    uint64_t index = __atomic_fetch_add(&trace->next, 1, __ATOMIC_RELAXED);
+    TraceEvent *event = &trace->events[index & (TRACE_CAPACITY - 1)];
+
+    // Readers skip the event until it is written
+    __atomic_store_n(&event->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    event->time = Stats_Now();
+    event->type = type;
+    event->thread = traceThread;
+    event->from = from;
+    event->to = to;
+    __atomic_store_n(&event->sequence, index + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Writes the events of the trace, oldest first, in the Chrome trace event
+ * format. Events that are overwritten while they are read are left out.
+ */
+void Trace_Dump(Trace *trace, FILE *file) {
+    uint64_t end = __atomic_load_n(&trace->next, __ATOMIC_ACQUIRE);
+    uint64_t start = end > TRACE_CAPACITY ? end - TRACE_CAPACITY : 0;
+    int pid = (int)getpid();
+    bool first = true;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (uint64_t index = start; index < end; index++) {
+        TraceEvent *slot = &trace->events[index & (TRACE_CAPACITY - 1)];
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != index + 1) {
+            continue;
+        }
+        TraceEvent event = *slot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != index + 1) {
+            continue;
+        }
+
+        TraceEventFormat format = traceEventFormats[event.type];
+        fprintf(file,
+                "%s\n{\"name\":\"%s\",\"cat\":\"gc\",\"ph\":\"%c\","
+                "\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%u",
+                first ? "" : ",", format.name, format.phase,
+                (unsigned long long)(event.time / 1000),
+                (unsigned long long)(event.time % 1000), pid, event.thread);
+        if (format.phase == 'i') {
+            fprintf(file, ",\"s\":\"t\"");
+        }
+        if (event.type == trace_grow_small_heap ||
+            event.type == trace_grow_large_heap) {
+            fprintf(file, ",\"args\":{\"from\":%llu,\"to\":%llu}",
+                    (unsigned long long)event.from,
+                    (unsigned long long)event.to);
+        }
+        fprintf(file, "}");
+        first = false;
+    }
+    fprintf(file, "\n]}\n");
+}
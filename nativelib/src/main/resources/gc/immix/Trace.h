@@ -0,0 +1,54 @@
+#ifndef IMMIX_TRACE_H
+#define IMMIX_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "Constants.h"
+
+/**
+ * Events of the collector kept in the trace. The ones that come in pairs
+ * delimit a phase, the others mark a point in time.
+ */
+typedef enum {
+    trace_collection_start,
+    trace_collection_end,
+    trace_pause_start,
+    trace_pause_end,
+    trace_roots_scanned,
+    trace_mark_done,
+    trace_sweep_done,
+    trace_grow_small_heap,
+    trace_grow_large_heap,
+    trace_overflow_rescan_start,
+    trace_overflow_rescan_end,
+} TraceEventType;
+
+/**
+ * Heap grows record the old and the new size of the heap in `from` and `to`.
+ * `sequence` is the index of the event plus one, it is `0` while the event is
+ * written.
+ */
+typedef struct {
+    uint64_t sequence;
+    uint64_t time;
+    uint32_t type;
+    uint32_t thread;
+    uint64_t from;
+    uint64_t to;
+} TraceEvent;
+
+/**
+ * Ring buffer of the last `TRACE_CAPACITY` events. Any thread can record an
+ * event without locking, the oldest events are overwritten.
+ */
+typedef struct {
+    uint64_t next;
+    uint32_t threadCount;
+    TraceEvent events[TRACE_CAPACITY];
+} Trace;
+
+void Trace_Record(Trace *trace, TraceEventType type, uint64_t from,
+                  uint64_t to);
+void Trace_Dump(Trace *trace, FILE *file);
+
+#endif // IMMIX_TRACE_H
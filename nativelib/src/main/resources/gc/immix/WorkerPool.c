@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "WorkerPool.h"
+#include "Log.h"
+
+typedef struct {
+    WorkerPool *pool;
+    int id;
+} WorkerPool_Worker;
+
+void *WorkerPool_loop(void *arg) {
+    WorkerPool_Worker *worker = (WorkerPool_Worker *)arg;
+    WorkerPool *pool = worker->pool;
+    uint64_t epoch = 0;
+
+    while (true) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->epoch == epoch) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        epoch = pool->epoch;
+        WorkerPool_Task task = pool->task;
+        void *taskArg = pool->arg;
+        pthread_mutex_unlock(&pool->lock);
+
+        task(worker->id, taskArg);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+void WorkerPool_Init(WorkerPool *pool, int count) {
+    assert(count >= 1);
+    pool->count = count;
+    pool->epoch = 0;
+    pool->pending = 0;
+    pool->task = NULL;
+    pool->arg = NULL;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pool->threads = malloc((count - 1) * sizeof(pthread_t));
+    for (int i = 1; i < count; i++) {
+        WorkerPool_Worker *worker = malloc(sizeof(WorkerPool_Worker));
+        worker->pool = pool;
+        worker->id = i;
+        if (pthread_create(&pool->threads[i - 1], NULL, WorkerPool_loop,
+                           worker) != 0) {
+            // Run with the threads we managed to start
+            free(worker);
+            pool->count = i;
+            break;
+        }
+        pthread_detach(pool->threads[i - 1]);
+    }
+}
+
+/**
+ * Runs `task` on every worker of the pool, including the calling thread, and
+ * returns once all of them are done.
+ */
+void WorkerPool_Run(WorkerPool *pool, WorkerPool_Task task, void *arg) {
+    if (pool->count == 1) {
+        task(0, arg);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->arg = arg;
+    pool->pending = pool->count - 1;
+    pool->epoch++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    task(0, arg);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
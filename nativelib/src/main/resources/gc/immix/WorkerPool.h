@@ -0,0 +1,28 @@
+#ifndef IMMIX_WORKERPOOL_H
+#define IMMIX_WORKERPOOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+typedef void (*WorkerPool_Task)(int workerId, void *arg);
+
+/**
+ * Pool of GC threads. The thread that calls `WorkerPool_Run` takes part in the
+ * work as worker `0`, thus a pool of `count` workers owns `count - 1` threads.
+ */
+typedef struct {
+    int count;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t epoch;
+    int pending;
+    WorkerPool_Task task;
+    void *arg;
+} WorkerPool;
+
+void WorkerPool_Init(WorkerPool *pool, int count);
+void WorkerPool_Run(WorkerPool *pool, WorkerPool_Task task, void *arg);
+
+#endif // IMMIX_WORKERPOOL_H
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "WriteBarrier.h"
+#include "Block.h"
+#include "Object.h"
+#include "Log.h"
+#include "State.h"
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+// Buffers waiting for the concurrent marker
+static LogBuffer *fullBuffers = NULL;
+// Buffers the marker is done with, reused by the mutator threads
+static LogBuffer *freeBuffers = NULL;
+
+/**
+ * Returns an empty buffer that the marker is done with, or `NULL` if there is
+ * none. The mutator threads only take the lock in critical regions, so that
+ * it is never held by a stopped thread.
+ */
+LogBuffer *WriteBarrier_TakeFreeBuffer() {
+    pthread_mutex_lock(&lock);
+    LogBuffer *buffer = freeBuffers;
+    if (buffer != NULL) {
+        freeBuffers = buffer->next;
+    }
+    pthread_mutex_unlock(&lock);
+
+    if (buffer != NULL) {
+        buffer->next = NULL;
+        buffer->count = 0;
+    }
+    return buffer;
+}
+
+/**
+ * Allocates an empty buffer. This calls `malloc`, whose lock might be held by
+ * a stopped thread, thus it must not be called in a critical region.
+ */
+LogBuffer *WriteBarrier_NewBuffer() {
+    LogBuffer *buffer = malloc(sizeof(LogBuffer));
+    if (buffer == NULL) {
+        printf("Out of memory for the write barrier\n");
+        exit(1);
+    }
+    buffer->next = NULL;
+    buffer->count = 0;
+    return buffer;
+}
+
+void WriteBarrier_publish(LogBuffer *buffer) {
+    pthread_mutex_lock(&lock);
+    buffer->next = fullBuffers;
+    fullBuffers = buffer;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Logs the object referenced by `slot` before it gets overwritten, unless it
+ * was already marked, to the `buffer` of the calling thread, which must not be
+ * `NULL`. Only slots of heap objects are logged, everything else is either a
+ * root or not traced at all.
+ */
+void WriteBarrier_LogSlot(Heap *heap, LogBuffer **buffer, word_t **slot) {
+    if (!Heap_IsWordInHeap(heap, (word_t *)slot)) {
+        return;
+    }
+    Object *object = Object_FromMutatorAddress(*slot);
+    if (!heap_isObjectInHeap(heap, object) || Object_IsMarked(object)) {
+        return;
+    }
+
+    LogBuffer *current = *buffer;
+    current->objects[current->count++] = object;
+    if (current->count == WRITE_BARRIER_BUFFER_SIZE) {
+        WriteBarrier_publish(current);
+        *buffer = NULL;
+    }
+}
+
+/**
+ * Records that `slot` might be about to hold a reference from an old object
+ * to a young one. Lines of the small heap are only dirtied when they are
+ * marked, as unmarked lines only hold objects allocated since the last
+ * collection. Chunks of the large heap are always dirtied.
+ */
+void WriteBarrier_MarkCard(Heap *heap, word_t **slot) {
+    word_t *address = (word_t *)slot;
+    if (Heap_IsWordInSmallHeap(heap, address)) {
+        BlockHeader *blockHeader = Block_GetBlockHeader(address);
+        LineHeader *lineHeader = Block_GetLineHeader(
+            blockHeader, Block_GetLineIndexFromWord(blockHeader, address));
+        if (Line_IsMarked(lineHeader) && !Line_IsDirty(lineHeader)) {
+            Line_SetDirty(lineHeader);
+        }
+    } else if (Heap_IsWordInLargeHeap(heap, address)) {
+        Bitmap_SetBitAtomic(largeAllocator.cards, (ubyte_t *)address);
+    }
+}
+
+/**
+ * Hands the buffer of a thread over to the marker, even if it is not full
+ * yet.
+ */
+void WriteBarrier_Flush(LogBuffer **buffer) {
+    if (*buffer != NULL) {
+        WriteBarrier_publish(*buffer);
+        *buffer = NULL;
+    }
+}
+
+/**
+ * @return a buffer logged by the mutator threads or `NULL` if there is none
+ */
+LogBuffer *WriteBarrier_TakeBuffer() {
+    pthread_mutex_lock(&lock);
+    LogBuffer *buffer = fullBuffers;
+    if (buffer != NULL) {
+        fullBuffers = buffer->next;
+    }
+    pthread_mutex_unlock(&lock);
+    return buffer;
+}
+
+void WriteBarrier_ReleaseBuffer(LogBuffer *buffer) {
+    pthread_mutex_lock(&lock);
+    buffer->next = freeBuffers;
+    freeBuffers = buffer;
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,40 @@
+#ifndef IMMIX_WRITEBARRIER_H
+#define IMMIX_WRITEBARRIER_H
+
+#include "GCTypes.h"
+#include "Heap.h"
+#include "headers/ObjectHeader.h"
+
+#define WRITE_BARRIER_BUFFER_SIZE 1024
+
+/**
+ * Kind of barrier behind the calls the compiler emits, set in
+ * `__write_barrier`.
+ */
+typedef enum {
+    write_barrier_none = 0x0,
+    write_barrier_snapshot = 0x1,
+    write_barrier_card = 0x2,
+} WriteBarrierKind;
+
+/**
+ * Objects logged by the snapshot-at-the-beginning write barrier. Every
+ * mutator thread fills its own buffer, full buffers are handed over to the
+ * concurrent marker. The buffer of a thread is kept in its `MutatorThread`,
+ * so that the collector can flush it once the thread is stopped.
+ */
+typedef struct LogBuffer {
+    struct LogBuffer *next;
+    uint32_t count;
+    Object *objects[WRITE_BARRIER_BUFFER_SIZE];
+} LogBuffer;
+
+LogBuffer *WriteBarrier_TakeFreeBuffer();
+LogBuffer *WriteBarrier_NewBuffer();
+void WriteBarrier_LogSlot(Heap *heap, LogBuffer **buffer, word_t **slot);
+void WriteBarrier_MarkCard(Heap *heap, word_t **slot);
+void WriteBarrier_Flush(LogBuffer **buffer);
+LogBuffer *WriteBarrier_TakeBuffer();
+void WriteBarrier_ReleaseBuffer(LogBuffer *buffer);
+
+#endif // IMMIX_WRITEBARRIER_H
@@ -1,16 +1,32 @@
 #include <string.h>
+#include <stdio.h>
+#include <sys/mman.h>
 #include "Bitmap.h"
 #include "../Constants.h"
 #include "../Log.h"
 #include "../utils/MathUtils.h"
 
+/**
+ * Maps zeroed memory for `nbWords` words. The bitmaps grow while the mutator
+ * threads are stopped, and one of them might hold the lock of `malloc`.
+ */
+word_t *Bitmap_mapWords(size_t nbWords) {
+    void *words = mmap(NULL, nbWords * WORD_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (words == MAP_FAILED) {
+        printf("Out of memory for the heap bitmaps\n");
+        exit(1);
+    }
+    return (word_t *)words;
+}
+
 Bitmap *Bitmap_Alloc(size_t size, word_t *offset) {
     assert(size % BITMAP_GRANULARITY == 0);
 
     size_t nbBlocks = size / BITMAP_GRANULARITY;
 
     unsigned long nbWords = MathUtils_DivAndRoundUp(nbBlocks, BITS_PER_WORD);
-    void *words = calloc(nbWords, WORD_SIZE);
+    word_t *words = Bitmap_mapWords(nbWords);
     Bitmap *bitmap = malloc(sizeof(Bitmap));
     bitmap->words = words;
     bitmap->size = size;
@@ -29,6 +45,21 @@ void Bitmap_SetBit(Bitmap *bitmap, ubyte_t *addr) {
     bitmap->words[WORD_OFFSET(index)] |= (1LLU << BIT_OFFSET(index));
 }
 
+/**
+ * Sets the bit of `addr`, other threads might set bits of the same word.
+ *
+ * @return `true` if the bit was set by this call
+ */
+bool Bitmap_SetBitAtomic(Bitmap *bitmap, ubyte_t *addr) {
+    assert(addr >= bitmap->offset &&
+           addr < bitmap->offset + bitmap->size * MIN_BLOCK_SIZE);
+    size_t index = addressToIndex(bitmap->offset, addr);
+    word_t bit = 1LLU << BIT_OFFSET(index);
+    word_t previous = __atomic_fetch_or(&bitmap->words[WORD_OFFSET(index)],
+                                        bit, __ATOMIC_ACQ_REL);
+    return (previous & bit) == 0;
+}
+
 void Bitmap_ClearBit(Bitmap *bitmap, ubyte_t *addr) {
     assert(addr >= bitmap->offset &&
            addr < bitmap->offset + bitmap->size * MIN_BLOCK_SIZE);
@@ -48,6 +79,85 @@ int Bitmap_GetBit(Bitmap *bitmap, ubyte_t *addr) {
     return bit != 0;
 }
 
+/**
+ * Finds the closest address at or before `addr` whose bit is set.
+ *
+ * @return the address, or `NULL` if no bit is set before `addr`.
+ */
+ubyte_t *Bitmap_FindPreviousSetBit(Bitmap *bitmap, ubyte_t *addr) {
+    assert(addr >= bitmap->offset &&
+           addr < bitmap->offset + bitmap->size * MIN_BLOCK_SIZE);
+
+    size_t index = addressToIndex(bitmap->offset, addr);
+    size_t wordIndex = WORD_OFFSET(index);
+    // Ignores the bits after `index` in its word
+    word_t bits = bitmap->words[wordIndex] &
+                  (~0LLU >> (BITS_PER_WORD - 1 - BIT_OFFSET(index)));
+    while (bits == 0) {
+        if (wordIndex == 0) {
+            return NULL;
+        }
+        bits = bitmap->words[--wordIndex];
+    }
+    size_t found = wordIndex * BITS_PER_WORD + MathUtils_LastSetBit(bits);
+    return bitmap->offset + found * BITMAP_GRANULARITY;
+}
+
+/**
+ * Finds the closest address at or after `addr` whose bit is set.
+ *
+ * @return the address, or the end of the bitmap if no bit is set after `addr`.
+ */
+ubyte_t *Bitmap_FindNextSetBit(Bitmap *bitmap, ubyte_t *addr) {
+    assert(addr >= bitmap->offset &&
+           addr < bitmap->offset + bitmap->size * MIN_BLOCK_SIZE);
+
+    size_t index = addressToIndex(bitmap->offset, addr);
+    size_t wordIndex = WORD_OFFSET(index);
+    size_t nbWords = MathUtils_DivAndRoundUp(
+        bitmap->size / BITMAP_GRANULARITY, BITS_PER_WORD);
+    // Ignores the bits before `index` in its word
+    word_t bits = bitmap->words[wordIndex] & (~0LLU << BIT_OFFSET(index));
+    while (bits == 0) {
+        if (++wordIndex == nbWords) {
+            return bitmap->offset + bitmap->size;
+        }
+        bits = bitmap->words[wordIndex];
+    }
+    size_t found = wordIndex * BITS_PER_WORD + MathUtils_FirstSetBit(bits);
+    return bitmap->offset + found * BITMAP_GRANULARITY;
+}
+
+/**
+ * Clears the bits of the addresses from `from` until `to`, a word at a time.
+ */
+void Bitmap_ClearRange(Bitmap *bitmap, ubyte_t *from, ubyte_t *to) {
+    size_t start = addressToIndex(bitmap->offset, from);
+    size_t end = addressToIndex(bitmap->offset, to);
+    if (start == end) {
+        return;
+    }
+    size_t lastIndex = end - 1;
+    size_t first = WORD_OFFSET(start);
+    size_t last = WORD_OFFSET(lastIndex);
+    for (size_t i = first; i <= last; i++) {
+        word_t mask = ~0LLU;
+        if (i == first) {
+            mask &= ~0LLU << BIT_OFFSET(start);
+        }
+        if (i == last) {
+            mask &= ~0LLU >> (BITS_PER_WORD - 1 - BIT_OFFSET(lastIndex));
+        }
+        bitmap->words[i] &= ~mask;
+    }
+}
+
+void Bitmap_ClearAll(Bitmap *bitmap) {
+    size_t nbBlocks = bitmap->size / BITMAP_GRANULARITY;
+    memset(bitmap->words, 0,
+           MathUtils_DivAndRoundUp(nbBlocks, BITS_PER_WORD) * WORD_SIZE);
+}
+
 // increment in bytes
 void Bitmap_Grow(Bitmap *bitmap, size_t increment) {
     assert(increment % BITMAP_GRANULARITY == 0);
@@ -60,9 +170,10 @@ void Bitmap_Grow(Bitmap *bitmap, size_t increment) {
     size_t totalNbWords =
         MathUtils_DivAndRoundUp(nbBlocks + nbBlockIncrement, BITS_PER_WORD);
 
-    bitmap->words = realloc(bitmap->words, totalNbWords * WORD_SIZE);
+    // Fresh mappings are zeroed
+    word_t *words = Bitmap_mapWords(totalNbWords);
+    memcpy(words, bitmap->words, previousNbWords * WORD_SIZE);
+    munmap(bitmap->words, previousNbWords * WORD_SIZE);
+    bitmap->words = words;
     bitmap->size += increment;
-
-    memset(bitmap->words + previousNbWords, 0,
-           (totalNbWords - previousNbWords) * WORD_SIZE);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define IMMIX_BITMAP_H
 
 #include <stddef.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <limits.h>
 #include "../GCTypes.h"
@@ -22,10 +23,20 @@ Bitmap *Bitmap_Alloc(size_t size, word_t *offset);
 
 void Bitmap_SetBit(Bitmap *bitmap, ubyte_t *addr);
 
+bool Bitmap_SetBitAtomic(Bitmap *bitmap, ubyte_t *addr);
+
 void Bitmap_ClearBit(Bitmap *bitmap, ubyte_t *addr);
 
 int Bitmap_GetBit(Bitmap *bitmap, ubyte_t *addr);
 
+ubyte_t *Bitmap_FindPreviousSetBit(Bitmap *bitmap, ubyte_t *addr);
+
+ubyte_t *Bitmap_FindNextSetBit(Bitmap *bitmap, ubyte_t *addr);
+
+void Bitmap_ClearRange(Bitmap *bitmap, ubyte_t *from, ubyte_t *to);
+
+void Bitmap_ClearAll(Bitmap *bitmap);
+
 void Bitmap_Grow(Bitmap *bitmap, size_t nb_words);
 
 #endif // IMMIX_BITMAP_H
@@ -12,16 +12,27 @@ BlockHeader *_getBlockFromIndex(word_t *heapStart, int32_t index) {
     return (BlockHeader *)(heapStart + (index * WORDS_IN_BLOCK));
 }
 
+/**
+ * `nextBlock` holds the index of the next block plus one, `0` stands for the
+ * block that directly follows, as in the blocks of a fresh heap.
+ */
 BlockHeader *_getNextBlock(word_t *heapStart, BlockHeader *header) {
     int32_t nextBlockId = header->header.nextBlock;
     if (nextBlockId == LAST_BLOCK) {
         return NULL;
     } else if (nextBlockId == 0) {
         nextBlockId = _getBlockIndex(heapStart, header) + 1;
+    } else {
+        nextBlockId--;
     }
     return _getBlockFromIndex(heapStart, nextBlockId);
 }
 
+void _setNextBlock(word_t *heapStart, BlockHeader *header,
+                   BlockHeader *next) {
+    header->header.nextBlock = _getBlockIndex(heapStart, next) + 1;
+}
+
 void BlockList_Init(BlockList *blockList, word_t *heapStart) {
     blockList->heapStart = heapStart;
     blockList->first = NULL;
@@ -32,13 +43,21 @@ inline bool BlockList_IsEmpty(BlockList *blockList) {
     return blockList->first == NULL;
 }
 
+/**
+ * Removes the first block of the list, or returns `NULL` if it is empty.
+ * Several threads can remove blocks at the same time without locking, as
+ * long as no block is added in the meantime.
+ */
 BlockHeader *BlockList_RemoveFirstBlock(BlockList *blockList) {
-    assert(blockList->first != NULL);
-    BlockHeader *block = blockList->first;
-    if (block == blockList->last) {
-        blockList->first = NULL;
+    BlockHeader *block = __atomic_load_n(&blockList->first, __ATOMIC_ACQUIRE);
+    while (block != NULL) {
+        // The last block has no next block, which empties the list
+        BlockHeader *next = _getNextBlock(blockList->heapStart, block);
+        if (__atomic_compare_exchange_n(&blockList->first, &block, next, true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            break;
+        }
     }
-    blockList->first = _getNextBlock(blockList->heapStart, block);
     return block;
 }
 
@@ -46,8 +65,7 @@ void BlockList_AddLast(BlockList *blockList, BlockHeader *blockHeader) {
     if (blockList->first == NULL) {
         blockList->first = blockHeader;
     } else {
-        blockList->last->header.nextBlock =
-            _getBlockIndex(blockList->heapStart, blockHeader);
+        _setNextBlock(blockList->heapStart, blockList->last, blockHeader);
     }
     blockList->last = blockHeader;
     blockHeader->header.nextBlock = LAST_BLOCK;
@@ -58,8 +76,7 @@ void BlockList_AddBlocksLast(BlockList *blockList, BlockHeader *first,
     if (blockList->first == NULL) {
         blockList->first = first;
     } else {
-        blockList->last->header.nextBlock =
-            _getBlockIndex(blockList->heapStart, first);
+        _setNextBlock(blockList->heapStart, blockList->last, first);
     }
     blockList->last = last;
     last->header.nextBlock = LAST_BLOCK;
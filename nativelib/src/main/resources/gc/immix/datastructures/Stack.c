@@ -1,40 +1,188 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <sys/mman.h>
 #include "Stack.h"
 #include "../Log.h"
 
+#define STACK_INDEX(buffer, index) ((index) & ((buffer)->nb_entries - 1))
+#define STACK_BUFFER_SIZE(nb_entries)                                          \
+    (sizeof(StackBuffer) + (nb_entries) * sizeof(Stack_Type))
+
+/**
+ * The buffers are mapped rather than allocated with `malloc`, as the stacks
+ * grow while the mutator threads are stopped, and one of them might hold the
+ * lock of `malloc`.
+ *
+ * @return the buffer, or `NULL` if there is no memory left
+ */
+StackBuffer *Stack_mapBuffer(size_t nb_entries) {
+    void *buffer = mmap(NULL, STACK_BUFFER_SIZE(nb_entries),
+                        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                        -1, 0);
+    if (buffer == MAP_FAILED) {
+        return NULL;
+    }
+    StackBuffer *stackBuffer = (StackBuffer *)buffer;
+    stackBuffer->nb_entries = nb_entries;
+    stackBuffer->retired = NULL;
+    return stackBuffer;
+}
+
 void Stack_Init(Stack *stack, size_t size) {
     assert(size % sizeof(Stack_Type) == 0);
+    size_t nb_entries = size / sizeof(Stack_Type);
+    assert((nb_entries & (nb_entries - 1)) == 0);
+    stack->top = 0;
     stack->current = 0;
-    stack->bottom = malloc(size);
-    stack->nb_words = size / sizeof(Stack_Type);
+    stack->buffer = Stack_mapBuffer(nb_entries);
+    if (stack->buffer == NULL) {
+        printf("Out of memory for the mark stack\n");
+        exit(1);
+    }
 }
 
-bool Stack_Push(Stack *stack, Stack_Type word) {
-    if (stack->current < stack->nb_words) {
-        stack->bottom[stack->current++] = word;
-        return false;
-    } else {
+/**
+ * Moves the entries from `top` to `current` to a buffer twice as large. The
+ * entries keep their indices, so the thieves that still read the old buffer
+ * find the same entries there.
+ */
+StackBuffer *Stack_grow(Stack *stack, StackBuffer *buffer, int64_t top,
+                        int64_t current) {
+    StackBuffer *grown = Stack_mapBuffer(buffer->nb_entries * 2);
+    if (grown == NULL) {
+        return NULL;
+    }
+    for (int64_t i = top; i < current; i++) {
+        grown->entries[STACK_INDEX(grown, i)] =
+            buffer->entries[STACK_INDEX(buffer, i)];
+    }
+    grown->retired = buffer;
+    __atomic_store_n(&stack->buffer, grown, __ATOMIC_RELEASE);
+    return grown;
+}
+
+/**
+ * Pushes an entry at the bottom of the stack, growing it if it is full. Must
+ * only be called by the owner.
+ *
+ * @return `true` if the stack could not grow and the entry was not pushed,
+ * `false` otherwise.
+ */
+bool Stack_Push(Stack *stack, Object *object, size_t start) {
+    int64_t current = __atomic_load_n(&stack->current, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&stack->top, __ATOMIC_ACQUIRE);
+    StackBuffer *buffer = __atomic_load_n(&stack->buffer, __ATOMIC_RELAXED);
+    if (current - top >= (int64_t)buffer->nb_entries) {
+        buffer = Stack_grow(stack, buffer, top, current);
+        if (buffer == NULL) {
 #ifdef PRINT_STACK_OVERFLOW
-        printf("Overflow !\n");
+            printf("Overflow !\n");
 #endif
+            return true;
+        }
+    }
+    Stack_Type *entry = &buffer->entries[STACK_INDEX(buffer, current)];
+    __atomic_store_n(&entry->object, object, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->start, start, __ATOMIC_RELAXED);
+    __atomic_store_n(&stack->current, current + 1, __ATOMIC_RELEASE);
+    return false;
+}
+
+/**
+ * Reads an entry word by word. An entry torn by a concurrent push is only
+ * read by a thief that then loses the race for it.
+ */
+static inline Stack_Type Stack_read(StackBuffer *buffer, int64_t index) {
+    Stack_Type *entry = &buffer->entries[STACK_INDEX(buffer, index)];
+    Stack_Type result;
+    result.object = __atomic_load_n(&entry->object, __ATOMIC_RELAXED);
+    result.start = __atomic_load_n(&entry->start, __ATOMIC_RELAXED);
+    return result;
+}
 
-        return true;
+/**
+ * Pops from the bottom of the stack. Must only be called by the owner.
+ *
+ * @return `true` if an entry was popped into `entry`, `false` if the stack is
+ * empty or the last entry was stolen concurrently.
+ */
+bool Stack_Pop(Stack *stack, Stack_Type *entry) {
+    int64_t current = __atomic_load_n(&stack->current, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&stack->current, current, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&stack->top, __ATOMIC_RELAXED);
+
+    if (top > current) {
+        // Empty
+        __atomic_store_n(&stack->current, current + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    *entry = Stack_read(stack->buffer, current);
+    if (top == current) {
+        // Last element, race against the thieves for it
+        bool won =
+            __atomic_compare_exchange_n(&stack->top, &top, top + 1, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&stack->current, current + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return true;
+}
+
+/**
+ * Pops from the bottom of the stack when no other thread steals from it,
+ * without the fence that orders `Stack_Pop` against the thieves.
+ */
+bool Stack_PopSerial(Stack *stack, Stack_Type *entry) {
+    int64_t current = stack->current - 1;
+    if (current < stack->top) {
+        return false;
     }
+    stack->current = current;
+    *entry = stack->buffer->entries[STACK_INDEX(stack->buffer, current)];
+    return true;
 }
 
-Stack_Type Stack_Pop(Stack *stack) {
-    assert(stack->current > 0);
-    return stack->bottom[--stack->current];
+/**
+ * Steals from the top of the stack. Can be called by any GC thread.
+ *
+ * @return `true` if an entry was stolen into `entry`, `false` if the stack is
+ * empty or another thread won the race for the entry.
+ */
+bool Stack_Steal(Stack *stack, Stack_Type *entry) {
+    int64_t top = __atomic_load_n(&stack->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t current = __atomic_load_n(&stack->current, __ATOMIC_ACQUIRE);
+
+    if (top >= current) {
+        return false;
+    }
+
+    // Read after `current`, the buffer holds at least the entries up to it
+    StackBuffer *buffer = __atomic_load_n(&stack->buffer, __ATOMIC_ACQUIRE);
+    *entry = Stack_read(buffer, top);
+    return __atomic_compare_exchange_n(&stack->top, &top, top + 1, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
 }
 
-bool Stack_IsEmpty(Stack *stack) { return stack->current == 0; }
+bool Stack_IsEmpty(Stack *stack) {
+    int64_t top = __atomic_load_n(&stack->top, __ATOMIC_ACQUIRE);
+    int64_t current = __atomic_load_n(&stack->current, __ATOMIC_ACQUIRE);
+    return current <= top;
+}
 
-void Stack_DoubleSize(Stack *stack) {
-    assert(stack->current == 0);
-    size_t nb_words = stack->nb_words * 2;
-    stack->nb_words = nb_words;
-    free(stack->bottom);
-    stack->bottom = malloc(nb_words * sizeof(Stack_Type));
+/**
+ * Unmaps the buffers replaced when the stack grew. The stack keeps its size
+ * for the next collections.
+ */
+void Stack_ReleaseRetired(Stack *stack) {
+    StackBuffer *retired = stack->buffer->retired;
+    stack->buffer->retired = NULL;
+    while (retired != NULL) {
+        StackBuffer *next = retired->retired;
+        munmap(retired, STACK_BUFFER_SIZE(retired->nb_entries));
+        retired = next;
+    }
 }
@@ -6,22 +6,53 @@
 
 #define INITIAL_STACK_SIZE (256 * 1024)
 
-typedef Object *Stack_Type;
-
+/**
+ * Work item of the mark stack: an object to scan, or the fields of an object
+ * array left to scan from index `start`.
+ */
+typedef struct {
+    Object *object;
+    size_t start;
+} Stack_Type;
+
+/**
+ * Buffer of a mark stack. The number of entries is a power of two, so that
+ * the indices can wrap around the buffer with a mask.
+ */
+typedef struct StackBuffer {
+    size_t nb_entries;
+    // Smaller buffer it replaced, which other GC threads might still read
+    struct StackBuffer *retired;
+    Stack_Type entries[];
+} StackBuffer;
+
+/**
+ * Mark stack of a single GC thread.
+ *
+ * The stack is a Chase-Lev work-stealing deque: the owning thread pushes and
+ * pops at the bottom, while the other GC threads steal from the top. When the
+ * buffer is full, `Stack_Push` moves the entries to a buffer twice as large.
+ * The old buffers stay mapped until `Stack_ReleaseRetired` is called once no
+ * thread steals anymore.
+ */
 typedef struct {
-    Stack_Type *bottom;
-    size_t nb_words;
-    int current;
+    StackBuffer *buffer;
+    int64_t top;
+    int64_t current;
 } Stack;
 
 void Stack_Init(Stack *stack, size_t size);
 
-bool Stack_Push(Stack *stack, Stack_Type word);
+bool Stack_Push(Stack *stack, Object *object, size_t start);
+
+bool Stack_Pop(Stack *stack, Stack_Type *entry);
+
+bool Stack_PopSerial(Stack *stack, Stack_Type *entry);
 
-Stack_Type Stack_Pop(Stack *stack);
+bool Stack_Steal(Stack *stack, Stack_Type *entry);
 
 bool Stack_IsEmpty(Stack *stack);
 
-void Stack_DoubleSize(Stack *stack);
+void Stack_ReleaseRetired(Stack *stack);
 
 #endif // IMMIX_STACK_H
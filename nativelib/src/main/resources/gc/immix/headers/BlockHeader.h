@@ -6,11 +6,14 @@
 #include "../GCTypes.h"
 #include "../Constants.h"
 #include "../Log.h"
+#include "../utils/MathUtils.h"
 
 typedef enum {
     block_free = 0x0,
     block_recyclable = 0x1,
-    block_unavailable = 0x2
+    block_unavailable = 0x2,
+    // Returned to the OS, out of the heap until it grows again
+    block_decommitted = 0x3
 } BlockFlag;
 
 typedef struct {
@@ -19,10 +22,22 @@ typedef struct {
         uint8_t flags;
         int16_t first;
         int32_t nextBlock;
+        // Free lines found by the last sweep
+        uint8_t freeLineCount;
+        // Set on the blocks whose objects get moved by the next mark
+        uint8_t evacuate;
     } header;
     LineHeader lineHeaders[LINE_COUNT];
+    // One bit per word of the lines, the bits of a line fit in one word. Start
+    // bits are set for the objects allocated in the block, the sweep clears
+    // them for the objects the collection did not mark.
+    uint32_t startBits[LINE_COUNT];
+    uint32_t markBits[LINE_COUNT];
 } BlockHeader;
 
+_Static_assert(sizeof(BlockHeader) <= BLOCK_METADATA_ALIGNED_SIZE,
+               "The block metadata does not fit in its lines");
+
 static inline bool Block_IsRecyclable(BlockHeader *blockHeader) {
     return blockHeader->header.flags == block_recyclable;
 }
@@ -32,6 +47,9 @@ static inline bool Block_IsUnavailable(BlockHeader *blockHeader) {
 static inline bool Block_IsFree(BlockHeader *blockHeader) {
     return blockHeader->header.flags == block_free;
 }
+static inline bool Block_IsDecommitted(BlockHeader *blockHeader) {
+    return blockHeader->header.flags == block_decommitted;
+}
 static inline void Block_SetFlag(BlockHeader *blockHeader,
                                  BlockFlag blockFlag) {
     blockHeader->header.flags = blockFlag;
@@ -45,8 +63,17 @@ static inline void Block_Unmark(BlockHeader *blockHeader) {
     blockHeader->header.mark = 0;
 }
 
-static inline void Block_Mark(BlockHeader *blockHeader) {
-    blockHeader->header.mark = 1;
+/**
+ * @return `true` if the block was marked by this call
+ */
+static inline bool Block_Mark(BlockHeader *blockHeader) {
+    return !Block_IsMarked(blockHeader) &&
+           __atomic_exchange_n(&blockHeader->header.mark, 1,
+                               __ATOMIC_RELAXED) == 0;
+}
+
+static inline bool Block_IsEvacuationCandidate(BlockHeader *blockHeader) {
+    return blockHeader->header.evacuate != 0;
 }
 
 static inline BlockHeader *Block_GetBlockHeader(word_t *word) {
@@ -101,4 +128,84 @@ static inline LineHeader *Block_GetLineHeader(BlockHeader *blockHeader,
     return &blockHeader->lineHeaders[lineIndex];
 }
 
+static inline uint32_t Block_GetWordIndex(BlockHeader *blockHeader,
+                                          word_t *word) {
+    return (uint32_t)(word - Block_GetFirstWord(blockHeader));
+}
+
+static inline bool Block_IsObjectStart(BlockHeader *blockHeader,
+                                       word_t *word) {
+    uint32_t index = Block_GetWordIndex(blockHeader, word);
+    return (blockHeader->startBits[index / WORDS_IN_LINE] &
+            (1U << (index % WORDS_IN_LINE))) != 0;
+}
+
+/**
+ * Records that an object starts at `word`. Atomic, as the GC threads that
+ * evacuate objects share blocks.
+ */
+static inline void Block_SetObjectStart(BlockHeader *blockHeader,
+                                        word_t *word) {
+    uint32_t index = Block_GetWordIndex(blockHeader, word);
+    __atomic_fetch_or(&blockHeader->startBits[index / WORDS_IN_LINE],
+                      1U << (index % WORDS_IN_LINE), __ATOMIC_RELAXED);
+}
+
+/**
+ * Finds the closest object that starts at or before `word` in the block.
+ *
+ * @return the first word of the object, or `NULL` if no object starts before
+ * `word`.
+ */
+static inline word_t *Block_FindObjectStart(BlockHeader *blockHeader,
+                                            word_t *word) {
+    uint32_t index = Block_GetWordIndex(blockHeader, word);
+    int lineIndex = index / WORDS_IN_LINE;
+    // Ignores the words after `word` in its line
+    uint32_t bits = blockHeader->startBits[lineIndex] &
+                    (~0U >> (WORDS_IN_LINE - 1 - index % WORDS_IN_LINE));
+    while (bits == 0) {
+        if (lineIndex == 0) {
+            return NULL;
+        }
+        bits = blockHeader->startBits[--lineIndex];
+    }
+    return Block_GetFirstWord(blockHeader) + lineIndex * WORDS_IN_LINE +
+           MathUtils_LastSetBit(bits);
+}
+
+static inline bool Block_IsObjectMarked(BlockHeader *blockHeader,
+                                        word_t *word) {
+    uint32_t index = Block_GetWordIndex(blockHeader, word);
+    uint32_t *bits = &blockHeader->markBits[index / WORDS_IN_LINE];
+    return (__atomic_load_n(bits, __ATOMIC_RELAXED) &
+            (1U << (index % WORDS_IN_LINE))) != 0;
+}
+
+/**
+ * @return `true` if the object at `word` was marked by this call
+ */
+static inline bool Block_MarkObject(BlockHeader *blockHeader, word_t *word) {
+    uint32_t index = Block_GetWordIndex(blockHeader, word);
+    uint32_t bit = 1U << (index % WORDS_IN_LINE);
+    uint32_t *bits = &blockHeader->markBits[index / WORDS_IN_LINE];
+    return (__atomic_load_n(bits, __ATOMIC_RELAXED) & bit) == 0 &&
+           (__atomic_fetch_or(bits, bit, __ATOMIC_ACQ_REL) & bit) == 0;
+}
+
+/**
+ * Same as `Block_MarkObject`, for a single GC thread with the world stopped.
+ */
+static inline bool Block_MarkObjectSerial(BlockHeader *blockHeader,
+                                          word_t *word) {
+    uint32_t index = Block_GetWordIndex(blockHeader, word);
+    uint32_t bit = 1U << (index % WORDS_IN_LINE);
+    uint32_t *bits = &blockHeader->markBits[index / WORDS_IN_LINE];
+    if ((*bits & bit) != 0) {
+        return false;
+    }
+    *bits |= bit;
+    return true;
+}
+
 #endif // IMMIX_BLOCKHEADER_H
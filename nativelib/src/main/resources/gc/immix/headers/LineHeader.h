@@ -4,7 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define FIRST_OBJECT_OFFSET_MASK (uint8_t)0xFC
+#define FIRST_OBJECT_OFFSET_MASK (uint8_t)0xF8
 
 typedef struct {
     int16_t next;
@@ -15,6 +15,7 @@ typedef enum {
     line_empty = 0x0,
     line_marked = 0x1,
     line_contains_object_header = 0x2,
+    line_dirty = 0x4,
 } LineFlag;
 
 /**
@@ -25,6 +26,8 @@ typedef enum {
  * flags.
  * Bit 0 is for marking
  * Bit 1 is for indicating if the line contains an object
+ * Bit 2 is set by the card-marking write barrier when a reference is stored
+ * in the line
  *
  */
 typedef uint8_t LineHeader;
@@ -32,13 +35,28 @@ typedef uint8_t LineHeader;
 static inline bool Line_IsMarked(LineHeader *lineHeader) {
     return (line_marked & *lineHeader) != 0;
 }
-static inline void Line_Mark(LineHeader *lineHeader) {
-    *lineHeader |= line_marked;
+/**
+ * @return `true` if the line was marked by this call
+ */
+static inline bool Line_Mark(LineHeader *lineHeader) {
+    return !Line_IsMarked(lineHeader) &&
+           (__atomic_fetch_or(lineHeader, line_marked, __ATOMIC_RELAXED) &
+            line_marked) == 0;
 }
 static inline void Line_Unmark(LineHeader *lineHeader) {
     *lineHeader &= ~line_marked;
 }
 
+static inline bool Line_IsDirty(LineHeader *lineHeader) {
+    return (line_dirty & *lineHeader) != 0;
+}
+static inline void Line_SetDirty(LineHeader *lineHeader) {
+    *lineHeader |= line_dirty;
+}
+static inline void Line_ClearDirty(LineHeader *lineHeader) {
+    *lineHeader &= ~line_dirty;
+}
+
 static inline void Line_SetEmpty(LineHeader *lineHeader) {
     *lineHeader = (uint8_t)line_empty;
 }
@@ -47,9 +65,15 @@ static inline bool Line_ContainsObject(LineHeader *lineHeader) {
     return (line_contains_object_header & *lineHeader) != 0;
 }
 
+/**
+ * Sets the offset of the first object of an empty line. The concurrent marker
+ * might be marking the line at the same time, so its mark bit is kept.
+ */
 static inline void Line_SetOffset(LineHeader *lineHeader, uint8_t offset) {
-    *lineHeader =
-        (offset & FIRST_OBJECT_OFFSET_MASK) | line_contains_object_header;
+    __atomic_fetch_or(lineHeader,
+                      (offset & FIRST_OBJECT_OFFSET_MASK) |
+                          line_contains_object_header,
+                      __ATOMIC_RELAXED);
 }
 
 static inline uint8_t Line_GetFirstObjectOffset(LineHeader *lineHeader) {
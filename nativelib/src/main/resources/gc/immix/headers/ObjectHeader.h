@@ -16,13 +16,18 @@ typedef enum {
 typedef enum {
     object_free = 0x0,
     object_allocated = 0x1,
-    object_marked = 0x2,
+    // Being moved out of an evacuation candidate by a GC thread
+    object_forwarding = 0x3,
+    // Moved, the new address is stored in place of the rtti
+    object_forwarded = 0x4,
 } ObjectFlag;
 
 typedef struct {
     uint32_t size;
     uint8_t type;
     uint8_t flag;
+    // Set once the address of the object was observed, it is never moved
+    uint8_t pinned;
 } ObjectHeader;
 
 typedef struct {
@@ -53,12 +58,12 @@ typedef struct {
     Field_t fields[0];
 } Object;
 
-static inline bool Object_IsMarked(ObjectHeader *objectHeader) {
-    return objectHeader->flag == object_marked;
+static inline bool Object_IsPinned(ObjectHeader *objectHeader) {
+    return objectHeader->pinned != 0;
 }
 
-static inline void Object_MarkObjectHeader(ObjectHeader *objectHeader) {
-    objectHeader->flag = object_marked;
+static inline void Object_Pin(ObjectHeader *objectHeader) {
+    objectHeader->pinned = 1;
 }
 
 static inline void Object_SetAllocated(ObjectHeader *objectHeader) {
@@ -69,6 +74,10 @@ static inline void Object_SetFree(ObjectHeader *objectHeader) {
     objectHeader->flag = object_free;
 }
 
+static inline bool Object_IsFree(ObjectHeader *objectHeader) {
+    return objectHeader->flag == object_free;
+}
+
 static inline bool Object_IsAllocated(ObjectHeader *objectHeader) {
     return objectHeader->flag == object_allocated;
 }
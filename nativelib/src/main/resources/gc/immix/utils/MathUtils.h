@@ -2,6 +2,7 @@
 #define IMMIX_MATHUTILS_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 static const int MultiplyDeBruijnBitPosition[32] = {
     0, 9,  1,  10, 13, 21, 2,  29, 11, 14, 16, 18, 22, 25, 3, 30,
@@ -31,4 +32,18 @@ static inline size_t MathUtils_DivAndRoundUp(size_t value, size_t divider) {
     return (value + divider - 1) / divider;
 }
 
+/**
+ * Index of the most significant set bit of `bits`, which must not be 0.
+ */
+static inline int MathUtils_LastSetBit(uint64_t bits) {
+    return 63 - __builtin_clzll(bits);
+}
+
+/**
+ * Index of the least significant set bit of `bits`, which must not be 0.
+ */
+static inline int MathUtils_FirstSetBit(uint64_t bits) {
+    return __builtin_ctzll(bits);
+}
+
 #endif // IMMIX_MATHUTILS_H
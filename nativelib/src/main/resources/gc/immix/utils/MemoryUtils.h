@@ -0,0 +1,36 @@
+#ifndef IMMIX_MEMORYUTILS_H
+#define IMMIX_MEMORYUTILS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+// The pages are freed right away and read as zeroes afterwards
+#define DECOMMIT_ADVICE MADV_DONTNEED
+#else
+// The pages are freed when the OS needs memory, their content is undefined
+#define DECOMMIT_ADVICE MADV_FREE
+#endif
+
+/**
+ * Returns the pages that lie entirely between `start` and `end` to the OS.
+ * The memory stays mapped, the pages are faulted back in when touched. Returns
+ * false if the OS refused, the memory is then left as is.
+ */
+static inline bool MemoryUtils_Decommit(void *start, void *end) {
+    static uintptr_t pageSize = 0;
+    if (pageSize == 0) {
+        pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    }
+    uintptr_t from = ((uintptr_t)start + pageSize - 1) & ~(pageSize - 1);
+    uintptr_t to = (uintptr_t)end & ~(pageSize - 1);
+    if (from < to) {
+        return madvise((void *)from, to - from, DECOMMIT_ADVICE) == 0;
+    }
+    return true;
+}
+
+#endif // IMMIX_MEMORYUTILS_H
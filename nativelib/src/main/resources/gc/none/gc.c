@@ -1,5 +1,9 @@
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 #include <sys/mman.h>
+#include "../GCStats.h"
 
 // Darwin defines MAP_ANON instead of MAP_ANONYMOUS
 #if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
@@ -20,11 +24,14 @@
 
 void *current = 0;
 void *end = 0;
+uint64_t mapped = 0;
+uint64_t allocated = 0;
 
 void scalanative_init() {
     current = mmap(NULL, CHUNK, DUMMY_GC_PROT, DUMMY_GC_FLAGS, DUMMY_GC_FD,
                    DUMMY_GC_FD_OFFSET);
     end = current + CHUNK;
+    mapped += CHUNK;
 }
 
 void *scalanative_alloc(void *info, size_t size) {
@@ -33,6 +40,7 @@ void *scalanative_alloc(void *info, size_t size) {
         void **alloc = current;
         *alloc = info;
         current += size;
+        allocated += size;
         return alloc;
     } else {
         scalanative_init();
@@ -53,3 +61,48 @@ void *scalanative_alloc_atomic(void *info, size_t size) {
 }
 
 void scalanative_collect() {}
+
+void scalanative_copy_references(void *to, void *from, size_t size) {
+    memmove(to, from, size);
+}
+
+bool scalanative_gc_moves_objects() { return false; }
+
+void scalanative_pin(void *address) {
+    (void)address;
+}
+
+void scalanative_register_thread(void *stackBottom) {
+    (void)stackBottom;
+}
+
+void scalanative_unregister_thread() {}
+
+// Nothing is ever collected nor freed
+void scalanative_gc_stats(GCStats *stats) {
+    memset(stats, 0, sizeof(GCStats));
+    stats->allocatedBytes = allocated;
+    stats->heapBytes = mapped;
+}
+
+// There is no trace, allocation profile nor heap dump to write
+int scalanative_gc_trace_dump(const char *path) {
+    (void)path;
+    return -1;
+}
+
+int scalanative_gc_profile_dump(const char *path, int format) {
+    (void)path;
+    (void)format;
+    return -1;
+}
+
+int scalanative_gc_heap_histogram(const char *path) {
+    (void)path;
+    return -1;
+}
+
+int scalanative_gc_heap_dump(const char *path) {
+    (void)path;
+    return -1;
+}
@@ -1,6 +1,11 @@
 #include <pthread.h>
 #include <sys/types.h>
 #include <string.h>
+#include <stdbool.h>
+
+// Provided by the garbage collector
+void scalanative_register_thread(void *stackBottom);
+void scalanative_unregister_thread();
 
 size_t scalanative_size_of_pthread_t() { return sizeof(pthread_t); }
 
@@ -63,4 +68,70 @@ int scalanative_pthread_process_private() { return PTHREAD_PROCESS_PRIVATE; }
 
 int scalanative_pthread_scope_process() { return PTHREAD_SCOPE_PROCESS; }
 
-int scalanative_pthread_scope_system() { return PTHREAD_SCOPE_SYSTEM; }
\ No newline at end of file
+int scalanative_pthread_scope_system() { return PTHREAD_SCOPE_SYSTEM; }
+
+typedef struct {
+    void *(*routine)(void *);
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t started;
+    bool registered;
+} scalanative_thread_start;
+
+void scalanative_thread_exit(void *unused) { scalanative_unregister_thread(); }
+
+void *scalanative_thread_run(void *arg) {
+    scalanative_thread_start *start = (scalanative_thread_start *)arg;
+    void *(*routine)(void *) = start->routine;
+    void *routineArg = start->arg;
+    void *result;
+
+    scalanative_register_thread(__builtin_frame_address(0));
+    // From now on `routineArg` is found on the stack of this thread
+    pthread_mutex_lock(&start->lock);
+    start->registered = true;
+    pthread_cond_signal(&start->started);
+    pthread_mutex_unlock(&start->lock);
+
+    pthread_cleanup_push(scalanative_thread_exit, NULL);
+    result = routine(routineArg);
+    pthread_cleanup_pop(1);
+    return result;
+}
+
+/**
+ * Starts a thread that is registered with the garbage collector. Returns once
+ * the thread is registered, so that `arg` stays reachable.
+ */
+int scalanative_pthread_create(pthread_t *thread, pthread_attr_t *attr,
+                               void *(*routine)(void *), void *arg) {
+    scalanative_thread_start start;
+    start.routine = routine;
+    start.arg = arg;
+    start.registered = false;
+    pthread_mutex_init(&start.lock, NULL);
+    pthread_cond_init(&start.started, NULL);
+
+    int result = pthread_create(thread, attr, scalanative_thread_run, &start);
+    if (result == 0) {
+        pthread_mutex_lock(&start.lock);
+        while (!start.registered) {
+            pthread_cond_wait(&start.started, &start.lock);
+        }
+        pthread_mutex_unlock(&start.lock);
+    }
+
+    pthread_cond_destroy(&start.started);
+    pthread_mutex_destroy(&start.lock);
+    return result;
+}
+
+int scalanative_pthread_detach(pthread_t thread) {
+    return pthread_detach(thread);
+}
+
+void scalanative_pthread_exit(void *retval) { pthread_exit(retval); }
+
+int scalanative_pthread_join(pthread_t thread, void **retval) {
+    return pthread_join(thread, retval);
+}
@@ -1,12 +1,18 @@
 #include <stdio.h>
 
 namespace __scalanative {
+// The runtime and the garbage collector can both register a hook
+#define MAX_HOOKS 4
+
 class Hook {
-    void (*hook)(void) = nullptr;
+    void (*hooks[MAX_HOOKS])(void) = {nullptr};
+    int count = 0;
     Hook() {}
     ~Hook() {
-        if (hook)
-            hook();
+        // The last registered hook runs first
+        while (count > 0) {
+            hooks[--count]();
+        }
     }
 
   public:
@@ -15,10 +21,10 @@ class Hook {
         return h;
     }
     void setHook(void (*h)(void)) {
-        if (!hook) {
-            hook = h;
+        if (count < MAX_HOOKS) {
+            hooks[count++] = h;
         } else {
-            fprintf(stderr, "Tried to set global hook multiple times\n");
+            fprintf(stderr, "Tried to set too many global hooks\n");
         }
     }
 };
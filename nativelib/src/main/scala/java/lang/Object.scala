@@ -9,6 +9,8 @@ class _Object {
     this eq that
 
   @inline def __hashCode(): scala.Int = {
+    // the address only stays a valid hash code if the gc never moves it
+    if (runtime.gcMovesObjects) runtime.GC.pin(this.cast[Ptr[scala.Byte]])
     val addr = this.cast[Word]
     addr.toInt ^ (addr >> 32).toInt
   }
@@ -45,6 +47,7 @@ class _Object {
     // This implementation is only called for classes that don't override
     // hashCode. Otherwise, whenever hashCode is overriden, we also update the
     // vtable entry for scala_## to point to the override directly.
+    if (runtime.gcMovesObjects) runtime.GC.pin(this.cast[Ptr[scala.Byte]])
     val addr = this.cast[Word]
     addr.toInt ^ (addr >> 32).toInt
   }
@@ -83,7 +83,12 @@ object Array {
       val toPtr   = to.at(toPos).cast[Ptr[Byte]]
       val size    = to.stride * len
 
-      `llvm.memmove.p0i8.p0i8.i64`(toPtr, fromPtr, size, 1, false)
+      // references overwritten by the copy go through the write barrier
+      if (to.isInstanceOf[ObjectArray]) {
+        GC.copy_references(toPtr, fromPtr, size)
+      } else {
+        `llvm.memmove.p0i8.p0i8.i64`(toPtr, fromPtr, size, 1, false)
+      }
     }
   }
 
@@ -10,10 +10,41 @@ import native._
  */
 @extern
 object GC {
+  /** Layout of `GCStats` in gc/GCStats.h, read through `GCStatsOps`. */
+  type GCStats = CStruct12[CUnsignedLongLong, // collections
+                           CUnsignedLongLong, // pause nanos
+                           CUnsignedLongLong, // max pause nanos
+                           CUnsignedLongLong, // mark nanos
+                           CUnsignedLongLong, // sweep nanos
+                           CUnsignedLongLong, // large sweep nanos
+                           CUnsignedLongLong, // allocated bytes
+                           CUnsignedLongLong, // freed bytes
+                           CUnsignedLongLong, // heap bytes
+                           CUnsignedLongLong, // free blocks
+                           CUnsignedLongLong, // recycled blocks
+                           CUnsignedLongLong] // unavailable blocks
+
   @name("scalanative_alloc")
   def alloc(info: Ptr[ClassType], size: CSize): Ptr[Byte] = extern
   @name("scalanative_alloc_atomic")
   def alloc_atomic(info: Ptr[ClassType], size: CSize): Ptr[Byte] = extern
   @name("scalanative_collect")
   def collect(): Unit = extern
+  @name("scalanative_gc_moves_objects")
+  def movesObjects(): CBool = extern
+  @name("scalanative_pin")
+  def pin(obj: Ptr[Byte]): Unit = extern
+  @name("scalanative_copy_references")
+  def copy_references(to: Ptr[Byte], from: Ptr[Byte], size: CSize): Unit =
+    extern
+  @name("scalanative_gc_stats")
+  def stats(buf: Ptr[GCStats]): Unit = extern
+  @name("scalanative_gc_trace_dump")
+  def dumpTrace(path: CString): CInt = extern
+  @name("scalanative_gc_profile_dump")
+  def dumpAllocationProfile(path: CString, format: CInt): CInt = extern
+  @name("scalanative_gc_heap_histogram")
+  def dumpHeapHistogram(path: CString): CInt = extern
+  @name("scalanative_gc_heap_dump")
+  def dumpHeap(path: CString): CInt = extern
 }
@@ -26,6 +26,22 @@ package object runtime {
     def idRangeTo: Long   = !(self._3._2)
   }
 
+  /** Counters of the gc, as filled by `GC.stats`. */
+  implicit class GCStatsOps(val self: Ptr[GC.GCStats]) extends AnyVal {
+    def collections: ULong       = !(self._1)
+    def pauseNanos: ULong        = !(self._2)
+    def maxPauseNanos: ULong     = !(self._3)
+    def markNanos: ULong         = !(self._4)
+    def sweepNanos: ULong        = !(self._5)
+    def largeSweepNanos: ULong   = !(self._6)
+    def allocatedBytes: ULong    = !(self._7)
+    def freedBytes: ULong        = !(self._8)
+    def heapBytes: ULong         = !(self._9)
+    def freeBlocks: ULong        = !(self._10)
+    def recycledBlocks: ULong    = !(self._11)
+    def unavailableBlocks: ULong = !(self._12)
+  }
+
   final val CLASS_KIND  = 0
   final val TRAIT_KIND  = 1
   final val STRUCT_KIND = 2
@@ -71,6 +87,9 @@ package object runtime {
   /** Read type information of given object. */
   def getType(obj: Object): Ptr[ClassType] = !obj.cast[Ptr[Ptr[ClassType]]]
 
+  /** Whether the gc moves objects, hashed objects are pinned only then. */
+  val gcMovesObjects: Boolean = GC.movesObjects()
+
   /** Get monitor for given object. */
   def getMonitor(obj: Object): Monitor = Monitor.dummy
 
@@ -38,11 +38,17 @@ object ScalaNativePlugin extends AutoPlugin {
       settingKey[String]("Compilation mode, either \"debug\" or \"release\".")
 
     val nativeGC =
-      settingKey[String]("GC choice, either \"none\", \"boehm\" or \"immix\".")
+      settingKey[String](
+        "GC choice, either \"none\", \"boehm\", \"immix\", " +
+          "\"immix-concurrent\" or \"immix-generational\".")
 
     val nativeLTO =
       taskKey[String](
         "LTO variant used for release mode (either \"none\", \"thin\" or \"full\").")
+
+    val nativeInlineAlloc =
+      settingKey[Boolean](
+        "Whether to inline the allocation fast path, for the GCs that support it.")
   }
 
   @deprecated("use autoImport instead", "0.3.7")
@@ -69,7 +69,10 @@ object ScalaNativePluginInternal {
       .getOrElse(build.GC.default.name),
     nativeGC in NativeTest := (nativeGC in Test).value,
     nativeLTO := Discover.LTO(),
-    nativeLTO in NativeTest := (nativeLTO in Test).value
+    nativeLTO in NativeTest := (nativeLTO in Test).value,
+    nativeInlineAlloc := Option(System.getenv.get("SCALANATIVE_INLINE_ALLOC"))
+      .exists(_ == "true"),
+    nativeInlineAlloc in NativeTest := (nativeInlineAlloc in Test).value
   )
 
   lazy val scalaNativeGlobalSettings: Seq[Setting[_]] = Seq(
@@ -129,6 +132,7 @@ object ScalaNativePluginInternal {
         .withMode(mode)
         .withLinkStubs(nativeLinkStubs.value)
         .withLTO(nativeLTO.value)
+        .withInlineAlloc(nativeInlineAlloc.value)
     },
     nativeLink := {
       val logger  = streams.value.log.toLogger
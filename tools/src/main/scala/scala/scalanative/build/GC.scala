@@ -10,18 +10,63 @@ package scala.scalanative.build
  *
  *  * Immix GC. Mostly-precise mark-region garbage collector.
  *
+ *  * Concurrent Immix GC. Immix that marks the heap concurrently
+ *    with the application, using a snapshot-at-the-beginning
+ *    write barrier emitted by the compiler.
+ *
+ *  * Generational Immix GC. Immix with sticky mark bits, minor
+ *    collections only trace objects allocated since the previous
+ *    collection, starting from a card-marking write barrier emitted
+ *    by the compiler.
+ *
  *  Additional GCs might be added to the list in the future.
  *
- *  @param dir name of the gc
+ *  @param name name of the gc
+ *  @param dir directory with the runtime sources of the gc
  *  @param links linking dependencies of the gc
+ *  @param writeBarrier whether reference stores go through a write barrier
+ *  @param inlineAlloc whether the runtime supports the bump pointer
+ *                     allocation of small objects inlined by the compiler,
+ *                     when `Config.inlineAlloc` is set
  */
-sealed abstract class GC private (val name: String, val links: Seq[String]) {
+sealed abstract class GC private (val name: String,
+                                  val dir: String,
+                                  val links: Seq[String],
+                                  val writeBarrier: Boolean,
+                                  val inlineAlloc: Boolean) {
   override def toString: String = name
 }
 object GC {
-  private[scalanative] final case object None  extends GC("none", Seq())
-  private[scalanative] final case object Boehm extends GC("boehm", Seq("gc"))
-  private[scalanative] final case object Immix extends GC("immix", Seq())
+  private[scalanative] final case object None
+      extends GC("none",
+                 "none",
+                 Seq(),
+                 writeBarrier = false,
+                 inlineAlloc = false)
+  private[scalanative] final case object Boehm
+      extends GC("boehm",
+                 "boehm",
+                 Seq("gc"),
+                 writeBarrier = false,
+                 inlineAlloc = false)
+  private[scalanative] final case object Immix
+      extends GC("immix",
+                 "immix",
+                 Seq(),
+                 writeBarrier = false,
+                 inlineAlloc = true)
+  private[scalanative] final case object ConcurrentImmix
+      extends GC("immix-concurrent",
+                 "immix",
+                 Seq(),
+                 writeBarrier = true,
+                 inlineAlloc = false)
+  private[scalanative] final case object GenerationalImmix
+      extends GC("immix-generational",
+                 "immix",
+                 Seq(),
+                 writeBarrier = true,
+                 inlineAlloc = true)
 
   /** Non-freeing garbage collector.*/
   def none: GC = None
@@ -32,6 +77,12 @@ object GC {
   /** Mostly-precise mark-region garbage collector. */
   def immix: GC = Immix
 
+  /** Mostly-precise mark-region garbage collector with concurrent marking. */
+  def concurrentImmix: GC = ConcurrentImmix
+
+  /** Mostly-precise mark-region garbage collector with minor collections. */
+  def generationalImmix: GC = GenerationalImmix
+
   /** The default garbage collector. */
   def default: GC = Immix
 
@@ -43,8 +94,13 @@ object GC {
       GC.Boehm
     case "immix" =>
       GC.Immix
+    case "immix-concurrent" =>
+      GC.ConcurrentImmix
+    case "immix-generational" =>
+      GC.GenerationalImmix
     case value =>
       throw new IllegalArgumentException(
-        "nativeGC can be either \"none\", \"boehm\" or \"immix\", not: " + value)
+        "nativeGC can be either \"none\", \"boehm\", \"immix\", " +
+          "\"immix-concurrent\" or \"immix-generational\", not: " + value)
   }
 }
@@ -63,7 +63,7 @@ private[scalanative] object LLVM {
     val optPath = libPath.resolve("optional").abs
     val (gcPath, gcSelPath) = {
       val gcPath    = libPath.resolve("gc")
-      val gcSelPath = gcPath.resolve(config.gc.name)
+      val gcSelPath = gcPath.resolve(config.gc.dir)
       (gcPath.abs, gcSelPath.abs)
     }
 
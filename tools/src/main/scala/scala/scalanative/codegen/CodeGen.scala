@@ -19,7 +19,7 @@ object CodeGen {
             assembly: Seq[Defn],
             dyns: Seq[String]): Unit = {
     implicit val top  = sema.Sema(assembly)
-    implicit val meta = new Metadata(top, dyns)
+    implicit val meta = new Metadata(config, top, dyns)
 
     val lowered = lower(assembly ++ Generate(Global.Top(config.mainClass)))
     emit(config, lowered)
@@ -25,6 +25,7 @@ object Generate {
       genModuleArray()
       genModuleArraySize()
       genObjectArrayId()
+      genWriteBarrier()
       genStackBottom()
       buf
     }
@@ -232,6 +233,25 @@ object Generate {
                       Val.Int(objectArray.id))
     }
 
+    def genWriteBarrier(): Unit = {
+      val enabled = meta.config.gc.writeBarrier
+      // kind of barrier the gc runtime implements behind the emitted calls
+      val kind = meta.config.gc match {
+        case build.GC.ConcurrentImmix   => 1
+        case build.GC.GenerationalImmix => 2
+        case _                          => 0
+      }
+
+      buf += Defn.Var(Attrs.None, writeBarrierName, Type.Int, Val.Int(kind))
+      // flag of the gc runtime checked by the barrier on reference stores
+      if (enabled) {
+        buf += Defn.Var(Attrs(isExtern = true),
+                        writeBarrierActiveName,
+                        Type.Byte,
+                        Val.None)
+      }
+    }
+
     def genTraitDispatchTables() = {
       buf += meta.tables.dispatchDefn
       buf += meta.tables.classHasTraitDefn
@@ -287,6 +307,10 @@ object Generate {
     val moduleArraySizeName = Global.Top("__modules_size")
 
     val objectArrayIdName = Global.Top("__object_array_id")
+
+    val writeBarrierName = Global.Top("__write_barrier")
+    val writeBarrierActiveName =
+      Global.Member(Global.Top("__extern"), "extern.__write_barrier_active")
   }
 
   val depends =
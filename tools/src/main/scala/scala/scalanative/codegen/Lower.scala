@@ -152,6 +152,8 @@ object Lower {
         genUnboxOp(buf, n, op, unwind)
       case op: Op.Module =>
         genModuleOp(buf, n, op, unwind)
+      case op: Op.Store =>
+        genStoreOp(buf, n, op, unwind)
       case _ =>
         buf.let(n, op, unwind)
     }
@@ -358,10 +360,90 @@ object Lower {
       val allocMethod =
         if (size < LARGE_OBJECT_MIN_SIZE) alloc else largeAlloc
 
-      buf.let(
-        n,
-        Op.Call(allocSig, allocMethod, Seq(rtti(cls).const, Val.Long(size))),
-        unwind)
+      if (meta.config.inlineAlloc && meta.config.gc.inlineAlloc &&
+          size <= INLINE_ALLOC_MAX_SIZE) {
+        genInlineAlloc(buf, n, rtti(cls).const, size, unwind)
+      } else {
+        buf.let(
+          n,
+          Op.Call(allocSig, allocMethod, Seq(rtti(cls).const, Val.Long(size))),
+          unwind)
+      }
+    }
+
+    // Bump allocates in the allocation buffer of the thread, the same way as
+    // Heap_AllocSmall in the immix runtime. The buffer is only accessed with
+    // volatile loads and stores, to keep them in its critical region.
+    def genInlineAlloc(buf: Buffer,
+                       n: Local,
+                       info: Val,
+                       size: Long,
+                       unwind: Next): Unit = {
+      import buf._
+
+      val allocSize = (size + 7) / 8 * 8 + OBJECT_HEADER_SIZE
+      val fastL, slowL, stopL, resumeL, doneL = fresh()
+
+      def bufferField(buffer: Val, index: Int): Val =
+        elem(allocBufferTy, buffer, Seq(Val.Int(0), Val.Int(index)), unwind)
+      def objectField(start: Val, ty: Type, index: Long): Val =
+        elem(ty, start, Seq(Val.Long(index)), unwind)
+
+      val buffer   = call(allocBufferSig, allocBuffer, Seq(), unwind)
+      val critical = bufferField(buffer, 0)
+      val cursor   = bufferField(buffer, 2)
+      store(Type.Byte, critical, Val.Byte(1), unwind, isVolatile = true)
+      val start = load(Type.Ptr, cursor, unwind, isVolatile = true)
+      val limit =
+        load(Type.Ptr, bufferField(buffer, 3), unwind, isVolatile = true)
+      val end  = objectField(start, Type.Byte, allocSize)
+      val fits = comp(Comp.Ule, Type.Ptr, end, limit, unwind)
+      branch(fits, Next(fastL), Next(slowL))
+
+      // the runtime zeroes the holes when the buffer takes them, so only
+      // the header of the object is written
+      label(fastL)
+      store(Type.Ptr, cursor, end, unwind, isVolatile = true)
+      store(Type.Int,
+            start,
+            Val.Int((allocSize / 8).toInt),
+            unwind,
+            isVolatile = true)
+      store(Type.Byte,
+            objectField(start, Type.Byte, 4),
+            Val.Byte(OBJECT_STANDARD),
+            unwind,
+            isVolatile = true)
+      store(Type.Byte,
+            objectField(start, Type.Byte, 5),
+            Val.Byte(OBJECT_ALLOCATED),
+            unwind,
+            isVolatile = true)
+      store(Type.Ptr,
+            objectField(start, Type.Ptr, 1),
+            info,
+            unwind,
+            isVolatile = true)
+      store(Type.Byte, critical, Val.Byte(0), unwind, isVolatile = true)
+      val stopRequested =
+        load(Type.Byte, bufferField(buffer, 1), unwind, isVolatile = true)
+      val stop = comp(Comp.Ine, Type.Byte, stopRequested, Val.Byte(0), unwind)
+      val obj  = objectField(start, Type.Byte, OBJECT_HEADER_SIZE)
+      branch(stop, Next(stopL), Next(resumeL))
+
+      label(stopL)
+      call(allocStopSig, allocStop, Seq(), unwind)
+      jump(resumeL, Seq())
+
+      label(resumeL)
+      jump(doneL, Seq(obj))
+
+      // the runtime leaves the critical region itself
+      label(slowL)
+      val slow = call(allocSig, allocSlow, Seq(info, Val.Long(size)), unwind)
+      jump(doneL, Seq(slow))
+
+      label(doneL, Seq(Val.Local(n, Type.Ptr)))
     }
 
     def genBinOp(buf: Buffer, n: Local, op: Op.Bin, unwind: Next): Unit = {
@@ -446,6 +528,53 @@ object Lower {
       buf.let(n, Op.Call(loadSig, load, Seq()), unwind)
     }
 
+    def genStoreOp(buf: Buffer, n: Local, op: Op.Store, unwind: Next) = {
+      import buf._
+
+      op match {
+        case Op.Store(ty: Type.RefKind, ptr, value, _)
+            if meta.config.gc.writeBarrier =>
+          val barrierL, storeL, stopL, doneL = fresh()
+
+          def bufferField(buffer: Val, index: Int): Val =
+            elem(allocBufferTy, buffer, Seq(Val.Int(0), Val.Int(index)), unwind)
+
+          // the flag is checked, the old value of the slot logged and the
+          // new one stored in the critical region of the thread, the same
+          // way as in genInlineAlloc, so that no collection starts or ends
+          // in between
+          val buffer   = call(allocBufferSig, allocBuffer, Seq(), unwind)
+          val critical = bufferField(buffer, 0)
+          store(Type.Byte, critical, Val.Byte(1), unwind, isVolatile = true)
+          val active =
+            load(Type.Byte, writeBarrierActive, unwind, isVolatile = true)
+          val cond = comp(Comp.Ine, Type.Byte, active, Val.Byte(0), unwind)
+          branch(cond, Next(barrierL), Next(storeL))
+
+          label(barrierL)
+          call(writeBarrierSig, writeBarrier, Seq(ptr), unwind)
+          jump(storeL, Seq())
+
+          label(storeL)
+          let(n, Op.Store(ty, ptr, value, isVolatile = true), unwind)
+          store(Type.Byte, critical, Val.Byte(0), unwind, isVolatile = true)
+          val stopRequested =
+            load(Type.Byte, bufferField(buffer, 1), unwind, isVolatile = true)
+          val stop =
+            comp(Comp.Ine, Type.Byte, stopRequested, Val.Byte(0), unwind)
+          branch(stop, Next(stopL), Next(doneL))
+
+          label(stopL)
+          call(allocStopSig, allocStop, Seq(), unwind)
+          jump(doneL, Seq())
+
+          label(doneL)
+
+        case _ =>
+          let(n, op, unwind)
+      }
+    }
+
     def genStringVal(value: String): Val = {
       val StringCls    = ClassRef.unapply(StringName).get
       val CharArrayCls = ClassRef.unapply(CharArrayName).get
@@ -505,6 +634,39 @@ object Lower {
     val largeAllocName = Global.Top("scalanative_alloc_large")
     val largeAlloc     = Val.Global(largeAllocName, allocSig)
 
+    // Objects up to this size are allocated inline when the gc supports it.
+    // It bounds the code emitted per allocation, and is the size of a line of
+    // immix: larger objects often do not fit in the hole of the allocation
+    // buffer, and go through the overflow allocation of the slow path anyway
+    val INLINE_ALLOC_MAX_SIZE = 256
+    val OBJECT_HEADER_SIZE    = 8
+    val OBJECT_STANDARD       = 1.toByte
+    val OBJECT_ALLOCATED      = 1.toByte
+
+    // Leading fields of the allocation buffer: the critical region and stop
+    // request flags, the cursor and the limit
+    val allocBufferTy =
+      Type.Struct(Global.None, Seq(Type.Byte, Type.Byte, Type.Ptr, Type.Ptr))
+
+    val allocBufferName = Global.Top("scalanative_alloc_buffer")
+    val allocBufferSig  = Type.Function(Seq(), Type.Ptr)
+    val allocBuffer     = Val.Global(allocBufferName, Type.Ptr)
+
+    val allocSlowName = Global.Top("scalanative_alloc_small_slow")
+    val allocSlow     = Val.Global(allocSlowName, allocSig)
+
+    val allocStopName = Global.Top("scalanative_alloc_stop")
+    val allocStopSig  = Type.Function(Seq(), Type.Void)
+    val allocStop     = Val.Global(allocStopName, Type.Ptr)
+
+    val writeBarrierName = Global.Top("scalanative_write_barrier")
+    val writeBarrierSig  = Type.Function(Seq(Type.Ptr), Type.Void)
+    val writeBarrier     = Val.Global(writeBarrierName, Type.Ptr)
+
+    val writeBarrierActiveName =
+      Global.Member(Global.Top("__extern"), "extern.__write_barrier_active")
+    val writeBarrierActive = Val.Global(writeBarrierActiveName, Type.Ptr)
+
     val dyndispatchName = Global.Top("scalanative_dyndispatch")
     val dyndispatchSig =
       Type.Function(Seq(Type.Ptr, Type.Int), Type.Ptr)
@@ -605,7 +767,11 @@ object Lower {
     val buf = mutable.UnrolledBuffer.empty[Defn]
     buf += Defn.Declare(Attrs.None, allocSmallName, allocSig)
     buf += Defn.Declare(Attrs.None, largeAllocName, allocSig)
+    buf += Defn.Declare(Attrs.None, allocBufferName, allocBufferSig)
+    buf += Defn.Declare(Attrs.None, allocSlowName, allocSig)
+    buf += Defn.Declare(Attrs.None, allocStopName, allocStopSig)
     buf += Defn.Declare(Attrs.None, dyndispatchName, dyndispatchSig)
+    buf += Defn.Declare(Attrs.None, writeBarrierName, writeBarrierSig)
     buf += Defn.Const(Attrs.None, unitName, unitTy, unitValue)
     buf += Defn.Declare(Attrs.None, throwName, throwSig)
     buf
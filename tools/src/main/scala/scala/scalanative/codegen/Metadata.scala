@@ -6,7 +6,7 @@ import scalanative.nir._
 import scalanative.sema._
 import scalanative.util.Stats
 
-class Metadata(top: Top, val dyns: Seq[String]) {
+class Metadata(val config: build.Config, top: Top, val dyns: Seq[String]) {
   import Metadata._
 
   val javaEquals    = top.nodes(javaEqualsName).asInstanceOf[Method]
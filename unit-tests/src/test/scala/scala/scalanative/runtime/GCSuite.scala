@@ -0,0 +1,120 @@
+package scala.scalanative
+package runtime
+
+import native._
+import posix.pthread._
+import posix.sys.types.pthread_t
+
+object GCSuite extends tests.Suite {
+  final class Node(val value: Int, val next: Node)
+
+  /** Builds lists of small objects, keeps one in ten of them, and checks
+   *  that the kept lists are intact once the others were collected.
+   */
+  def churn(seed: Int): Boolean = {
+    val kept = new Array[Node](100)
+    var round = 0
+    while (round < 1000) {
+      var list: Node = null
+      var i          = 0
+      while (i < 1000) {
+        list = new Node(seed + i, list)
+        i += 1
+      }
+      if (round % 10 == 0) {
+        kept(round / 10) = list
+      }
+      if (round % 250 == 0) {
+        GC.collect()
+      }
+      round += 1
+    }
+    kept.forall(isIntact(_, seed))
+  }
+
+  def isIntact(list: Node, seed: Int): Boolean = {
+    var node  = list
+    var value = seed + 999
+    while (node != null && node.value == value) {
+      node = node.next
+      value -= 1
+    }
+    node == null && value == seed - 1
+  }
+
+  /** Stores new objects into an array allocated before them, and copies
+   *  them between arrays, while collections run. The stores and copies go
+   *  through the write barrier of the concurrent and generational gcs.
+   */
+  def store(seed: Int): Boolean = {
+    val slots  = new Array[Node](1000)
+    val copies = new Array[Node](1000)
+    var round  = 0
+    while (round < 100) {
+      var i = 0
+      while (i < 1000) {
+        slots(i) = new Node(seed + i, null)
+        i += 1
+      }
+      System.arraycopy(slots, 0, copies, 0, 1000)
+      if (round % 25 == 0) {
+        GC.collect()
+      }
+      round += 1
+    }
+    (0 until 1000).forall { i =>
+      slots(i).value == seed + i && (copies(i) eq slots(i))
+    }
+  }
+
+  def work(seed: Int): Boolean = churn(seed) && store(seed)
+
+  /** Runs `work` on `count` threads at once. */
+  def workOnThreads(count: Int): Boolean = {
+    val threads = stackalloc[pthread_t](count)
+    val results = stackalloc[CInt](count)
+    val routine: CFunctionPtr1[Ptr[Byte], Ptr[Byte]] = (arg: Ptr[Byte]) => {
+      val result = arg.cast[Ptr[CInt]]
+      !result = if (GCSuite.work(!result * 1000000)) 1 else 0
+      null
+    }
+    var i = 0
+    while (i < count) {
+      results(i) = i
+      val arg = (results + i).cast[Ptr[Byte]]
+      assert(pthread_create(threads + i, null, routine, arg) == 0)
+      i += 1
+    }
+    i = 0
+    while (i < count) {
+      pthread_join(threads(i), null)
+      i += 1
+    }
+    (0 until count).forall(results(_) == 1)
+  }
+
+  test("objects allocated on one thread survive collections") {
+    assert(work(0))
+  }
+
+  // Only immix registers the threads created with `pthread_create`, the
+  // none gc is not thread-safe and boehm never sees them
+  val gcRegistersThreads =
+    Option(System.getenv("SCALA_NATIVE_GC")).exists(_.startsWith("immix"))
+
+  if (gcRegistersThreads) {
+    test("objects allocated on several threads survive collections") {
+      assert(workOnThreads(4))
+    }
+  }
+
+  test("stats count the allocated bytes") {
+    val before = stackalloc[GC.GCStats]
+    val after  = stackalloc[GC.GCStats]
+    GC.stats(before)
+    assert(churn(0))
+    GC.stats(after)
+    assert(after.allocatedBytes.toLong > before.allocatedBytes.toLong)
+    assert(after.heapBytes.toLong > 0)
+  }
+}